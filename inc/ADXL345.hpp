@@ -532,6 +532,11 @@ class ADXL345 {
     */
     void get_raw_data(void);
     /*
+    * Update the axes values from 6 bytes already read from ADXL345_DATA_X0
+    * onwards
+    */
+    void parse_raw_data(const uint8_t *raw);
+    /*
     * Returns the configuration of the FIFO
     */
     uint8_t get_fifo_ctrl(void);
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Geometry.hpp"
+#include "GY_85.hpp"
+
+// Gaps between samples longer than this restart the integration instead of
+// applying one huge step
+#define AHRS_MAX_STEP 0.1f
+
+enum AHRS_Algorithm {
+  // Gradient descent correction of the gyroscope integration (Madgwick)
+  AHRS_MADGWICK,
+  // Proportional-integral feedback of the measured direction error (Mahony)
+  AHRS_MAHONY
+};
+
+/*
+* Attitude and heading reference, fuses the gyroscope, accelerometer and
+* magnetometer into the orientation of the module as a quaternion from the
+* body frame to the earth frame.
+* Without a usable magnetometer reading a step only corrects roll and pitch.
+*/
+class AHRS {
+  public:
+    /*
+    * Madgwick uses gain_p as beta, the gradient step (rad/s), and ignores
+    * gain_i. Mahony uses both as the proportional and integral gains.
+    */
+    AHRS(AHRS_Algorithm algorithm = AHRS_MADGWICK, float gain_p = 0.1f, float gain_i = 0.0f);
+
+    /*
+    * One step of dt seconds
+    * Gyroscope in rad/s, accelerometer and magnetometer in any unit
+    */
+    void update(const Vector3 &gyros, const Vector3 &accel, const Vector3 &magnt, float dt);
+    /*
+    * Steps for a batch of GY_85 samples, each integrated over the time since
+    * the previous one. Samples without a new gyroscope reading are skipped.
+    */
+    void update(const GY_85_Sample *samples, size_t count);
+
+    Quaternion get_quaternion(void);
+    /*
+    * Roll, pitch and yaw in radians
+    */
+    Vector3 get_euler(void);
+    /*
+    * Timestamp of the last sample used, microseconds
+    */
+    uint64_t get_timestamp(void);
+    void set_gains(float gain_p, float gain_i);
+    void reset(const Quaternion &q = Quaternion::identity());
+
+  private:
+    AHRS_Algorithm _algorithm;
+    float _gain_p, _gain_i;
+
+    Quaternion _q;
+    // Mahony integral of the direction error
+    Vector3 _integral;
+    uint64_t _timestamp;
+
+    void madgwick(const Vector3 &g, const Vector3 &a, const Vector3 &m, float dt);
+    void mahony(const Vector3 &g, const Vector3 &a, const Vector3 &m, float dt);
+};
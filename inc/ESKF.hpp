@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Geometry.hpp"
+#include "Matrix.hpp"
+#include "GY_85.hpp"
+
+// Error state: position, velocity, attitude, accelerometer bias, gyroscope bias
+#define ESKF_N 15
+#define ESKF_P 0
+#define ESKF_V 3
+#define ESKF_THETA 6
+#define ESKF_BA 9
+#define ESKF_BG 12
+
+#define GRAVITY 9.80665f
+
+/*
+* Noise of the inertial sensors: standard deviation of one sample and
+* random walk of the biases per square root of second
+*/
+struct ESKF_Noise {
+  float accel;      // m/s²
+  float gyros;      // rad/s
+  float accel_bias; // m/s²/√s
+  float gyros_bias; // rad/s/√s
+};
+
+/*
+* Error-state Kalman filter for the 6-DoF pose of the scanner.
+* The nominal state (position, velocity, orientation and biases, earth frame
+* with z up) is integrated from the accelerometer and gyroscope, while a
+* 15-dimensional error state carries the covariance and absorbs the
+* corrections of the measurements, then is folded back into the nominal
+* state. Matrix sizes are fixed at compile time so nothing is allocated.
+*/
+class ESKF {
+  public:
+    ESKF(const ESKF_Noise &noise = {0.05f, 0.005f, 0.001f, 0.0001f});
+
+    /*
+    * Restart at a known pose, at rest
+    */
+    void reset(const Quaternion &q, const Vector3 &position = {0, 0, 0});
+    /*
+    * Propagate by dt seconds
+    * Accelerometer specific force in m/s², gyroscope in rad/s
+    */
+    void predict(const Vector3 &accel, const Vector3 &gyros, float dt);
+    /*
+    * Propagate to the timestamp of a GY_85 sample using its accelerometer
+    * and gyroscope, the first sample only sets the time
+    */
+    void predict(const GY_85_Sample &sample);
+
+    /*
+    * Pseudo-measurement of a scanner at rest, velocity zero within sigma m/s
+    */
+    bool update_zero_velocity(float sigma = 0.01f);
+    /*
+    * Heading from a magnetometer reading in the body frame, any unit
+    * Declination is the angle of magnetic north from the earth x axis,
+    * sigma in radians
+    */
+    bool update_heading(const Vector3 &magnt, float sigma = 0.05f, float declination = 0);
+    /*
+    * Range measured along a ray to a known plane normal·x = offset in the
+    * earth frame. The ray starts at origin with unit direction, both in the
+    * body frame. Range and sigma in meters.
+    */
+    bool update_range_to_plane(float range, const Vector3 &origin, const Vector3 &direction,
+      const Vector3 &normal, float offset, float sigma = 0.01f);
+
+    Vector3 get_position(void);
+    Vector3 get_velocity(void);
+    Quaternion get_orientation(void);
+    Vector3 get_accel_bias(void);
+    Vector3 get_gyros_bias(void);
+    uint64_t get_timestamp(void);
+    const Matrix<ESKF_N, ESKF_N> &get_covariance(void);
+
+  private:
+    ESKF_Noise _noise;
+
+    Vector3 _p, _v, _ba, _bg;
+    Quaternion _q;
+    Matrix<ESKF_N, ESKF_N> _P;
+    uint64_t _timestamp;
+
+    /*
+    * Kalman update of the error state with an M-dimensional residual,
+    * rejected if it falls outside the 99% gate of its innovation
+    */
+    template <size_t M>
+    bool update(const Matrix<M, 1> &residual, const Matrix<M, ESKF_N> &H, const Matrix<M, M> &R);
+    /*
+    * Fold the error state into the nominal state
+    */
+    void inject(const Matrix<ESKF_N, 1> &dx);
+};
@@ -1,12 +1,77 @@
 #pragma once
 
+#include <cstdint>
+
+#include "I2C.hpp"
+#include "ADXL345.hpp"
+#include "ITG_3205.hpp"
+#include "HMC5883L.hpp"
+
 #define ACCELERATOR_ADDR  0x53
 #define GYROSCOPE_ADDR    0x68
 #define COMPASS_ADDR      0x1E
 
+// Acceleration in g
+struct Accel {
+  float x, y, z;
+};
+
+// Angular rate in °/s
+struct Gyros {
+  float x, y, z;
+};
+
+// Magnetic field in mG
+struct Magnt {
+  float x, y, z;
+};
+
+/*
+* One reading of the whole module, the three sensors are read in the same
+* bus transaction so they share a single timestamp
+*/
+struct GY_85_Sample {
+  // CLOCK_MONOTONIC in microseconds, middle of the bus transaction
+  uint64_t timestamp;
+  Accel accel;
+  Gyros gyros;
+  Magnt magnt;
+  // Gyroscope die temperature in °C
+  float temperature;
+  // Whether each sensor produced a new output since the previous read, a
+  // stale sensor repeats its last values
+  bool accel_new, gyros_new, magnt_new;
+  // Accelerometer inactivity event since the previous read, only reported
+  // with GY_85::set_inactivity_detection enabled
+  bool accel_inactive;
+};
+
 class GY_85 {
   public:
-    GY_85(I2C &i2c);
+    /*
+    * Configure the three sensors for the given output data rate (see
+    * set_sample_rate) and start measuring
+    */
+    GY_85(I2C &i2c, uint16_t sample_rate = 100);
+
+    /*
+    * Set the output data rate of the accelerometer to the closest supported
+    * rate not below sample_rate and that of the gyroscope to the nearest
+    * 1kHz/(divider + 1), with its low pass filter under half of it.
+    * The magnetometer is limited to 75Hz and gets the closest rate not below
+    * sample_rate up to that.
+    */
+    bool set_sample_rate(uint16_t sample_rate);
+    /*
+    * Let the accelerometer flag inactivity when the acceleration of every
+    * axis stays within milli_gs of its starting value (ac-coupled) for
+    * seconds, reported in GY_85_Sample::accel_inactive
+    */
+    bool set_inactivity_detection(uint16_t milli_gs, uint8_t seconds);
+    /*
+    * Read all nine axes and the temperature in one combined bus transaction
+    */
+    bool read(GY_85_Sample &sample);
 
     Accel get_acceleration_data(void);
     Gyros get_gyroscope_data(void);
@@ -17,5 +82,8 @@ class GY_85 {
     HMC5883L compass;
     ITG_3205 gyroscope;
 
-
-}
+    // Magnetometer output period, the chip has no flag cleared on read
+    uint64_t _compass_period;
+    uint64_t _compass_timestamp;
+    uint8_t _compass_raw[6];
+};
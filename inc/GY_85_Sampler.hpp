@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+#include "GY_85.hpp"
+#include "RingBuffer.hpp"
+
+// Samples the sampler can hold before the consumer has to drain them, about
+// 10s at 100Hz
+#define GY_85_SAMPLER_CAPACITY 1024
+
+/*
+* Samples a GY_85 at a fixed rate from a dedicated thread, publishing every
+* sample into a ring buffer the consumer drains in batches, so a slow
+* consumer doesn't make the sampling miss its deadlines.
+* Only one consumer thread may call drain().
+*/
+class GY_85_Sampler {
+  public:
+    GY_85_Sampler(GY_85 &imu, uint16_t sample_rate);
+    ~GY_85_Sampler();
+
+    /*
+    * Start the sampling thread
+    * A non-zero priority runs it with SCHED_FIFO at that priority (1-99)
+    * and a cpu other than -1 pins it to that core. Both need privileges: if
+    * they can't be applied the thread keeps running with default scheduling
+    * and false is returned.
+    */
+    bool start(int priority = 0, int cpu = -1);
+    /*
+    * Stop the sampling thread, samples not yet drained stay available
+    */
+    void stop(void);
+    /*
+    * Move up to max_samples of the oldest samples into samples
+    * Returns how many were moved
+    */
+    size_t drain(GY_85_Sample *samples, size_t max_samples);
+    /*
+    * Samples read but dropped because the buffer was full
+    */
+    uint64_t get_overruns(void);
+    /*
+    * Sample periods skipped because the thread woke up too late
+    */
+    uint64_t get_missed_periods(void);
+    /*
+    * Failed bus transactions
+    */
+    uint64_t get_read_errors(void);
+
+  private:
+    GY_85 &_imu;
+    uint64_t _period_ns;
+
+    RingBuffer<GY_85_Sample, GY_85_SAMPLER_CAPACITY> _samples;
+
+    std::thread _thread;
+    std::atomic<bool> _running;
+    std::atomic<uint64_t> _overruns, _missed_periods, _read_errors;
+
+    void run(void);
+};
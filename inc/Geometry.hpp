@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cmath>
+
+struct Vector3 {
+  float x, y, z;
+
+  Vector3 operator+(const Vector3 &v) const {
+    return {x + v.x, y + v.y, z + v.z};
+  }
+  Vector3 operator-(const Vector3 &v) const {
+    return {x - v.x, y - v.y, z - v.z};
+  }
+  Vector3 operator*(float s) const {
+    return {x*s, y*s, z*s};
+  }
+  Vector3 &operator+=(const Vector3 &v) {
+    x += v.x; y += v.y; z += v.z;
+    return *this;
+  }
+  float dot(const Vector3 &v) const {
+    return x*v.x + y*v.y + z*v.z;
+  }
+  Vector3 cross(const Vector3 &v) const {
+    return {y*v.z - z*v.y, z*v.x - x*v.z, x*v.y - y*v.x};
+  }
+  float norm(void) const {
+    return std::sqrt(x*x + y*y + z*z);
+  }
+};
+
+/*
+* Rotation quaternion, w is the scalar part
+* A quaternion q rotates vectors from the body frame to the earth frame
+*/
+struct Quaternion {
+  float w, x, y, z;
+
+  static Quaternion identity(void) {
+    return {1, 0, 0, 0};
+  }
+  /*
+  * Rotation of angle radians around a unit axis
+  */
+  static Quaternion from_axis_angle(const Vector3 &axis, float angle) {
+    float s = std::sin(angle/2);
+    return {std::cos(angle/2), axis.x*s, axis.y*s, axis.z*s};
+  }
+  /*
+  * Rotation by a rotation vector (axis times angle in radians)
+  */
+  static Quaternion from_rotation_vector(const Vector3 &v) {
+    float angle = v.norm();
+    if(angle < 1e-6f) {
+      return Quaternion{1, v.x/2, v.y/2, v.z/2}.normalized();
+    }
+    return from_axis_angle(v*(1/angle), angle);
+  }
+
+  Quaternion operator*(const Quaternion &q) const {
+    return {
+      w*q.w - x*q.x - y*q.y - z*q.z,
+      w*q.x + x*q.w + y*q.z - z*q.y,
+      w*q.y - x*q.z + y*q.w + z*q.x,
+      w*q.z + x*q.y - y*q.x + z*q.w
+    };
+  }
+  Quaternion conjugate(void) const {
+    return {w, -x, -y, -z};
+  }
+  float dot(const Quaternion &q) const {
+    return w*q.w + x*q.x + y*q.y + z*q.z;
+  }
+  Quaternion normalized(void) const {
+    float n = 1/std::sqrt(w*w + x*x + y*y + z*z);
+    return {w*n, x*n, y*n, z*n};
+  }
+  /*
+  * Rotate a vector from the body frame to the earth frame
+  */
+  Vector3 rotate(const Vector3 &v) const {
+    // v + 2w(u x v) + 2u x (u x v), with u the vector part
+    Vector3 u = {x, y, z};
+    Vector3 t = u.cross(v)*2;
+    return v + t*w + u.cross(t);
+  }
+  /*
+  * Roll, pitch and yaw in radians (ZYX convention)
+  */
+  Vector3 to_euler(void) const {
+    float sin_pitch = 2*(w*y - z*x);
+    sin_pitch = sin_pitch > 1 ? 1 : (sin_pitch < -1 ? -1 : sin_pitch);
+    return {
+      std::atan2(2*(w*x + y*z), 1 - 2*(x*x + y*y)),
+      std::asin(sin_pitch),
+      std::atan2(2*(w*z + x*y), 1 - 2*(y*y + z*z))
+    };
+  }
+};
@@ -161,6 +161,11 @@ class HMC5883L {
     */
     void get_raw_data(void);
     /*
+    * Update the axes values from the 6 data bytes already read from
+    * HMC5883_DATA_OUTPUT_X_MSB onwards
+    */
+    void parse_raw_data(const uint8_t *raw);
+    /*
     * Return the device status
     *
     * Bit | Description
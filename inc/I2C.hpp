@@ -1,6 +1,18 @@
 #pragma once
 
 #include <cstdint>
+#include <mutex>
+
+/*
+* One message of a combined transaction, a write message to a register
+* carries the register address as its first data byte
+*/
+struct I2CMessage {
+  uint8_t device_address;
+  bool read;
+  uint8_t *data;
+  uint16_t length;
+};
 
 class I2C {
   public:
@@ -29,7 +41,18 @@ class I2C {
     */
     bool write_register(uint8_t deviceAddress, uint8_t registerAddress,
       uint8_t *dataPointer, uint8_t length=1);
+    /*
+    * @bref Send several messages as one combined transaction (repeated start
+    *       between messages) with a single system call
+    * @param Messages to transfer, in order
+    * @param How many messages
+    * @return true is succeeded and false if don't
+    */
+    bool transfer(I2CMessage *messages, uint32_t count);
 
   private:
     int _i2c_file;
+    // Each transaction selects the slave and then transfers, several sensors
+    // may be driven from different threads over the same bus
+    std::mutex _bus_mutex;
 };
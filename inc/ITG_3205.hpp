@@ -159,6 +159,11 @@ class ITG_3205 {
     */
     void get_raw_data(void);
     /*
+    * Update the temperature and axes values from 8 bytes already read
+    * from ITG_3205_TEMP_OUT_H onwards
+    */
+    void parse_raw_data(const uint8_t *raw);
+    /*
     * Return the power control, clock source of the device
     */
     uint8_t get_power_management_configuration(void);
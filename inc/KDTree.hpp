@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Geometry.hpp"
+#include "RangeProjector.hpp"
+#include "ThreadPool.hpp"
+
+// Points per leaf
+#define KDTREE_BUCKET 16
+
+// Most neighbours a k nearest query can ask for
+#define KDTREE_MAX_K 64
+
+#define KDTREE_NONE UINT32_MAX
+
+/*
+* Static k-d tree for neighbour searches over a finished point cloud.
+*
+* Nodes split their points at the median along the widest side of their
+* bounding box, so the tree is balanced and its shape only depends on the
+* point count: nodes sit in a flat array in heap order, children of node i
+* at 2i + 1 and 2i + 2, and leaves point to a range of at most
+* KDTREE_BUCKET consecutive points. The points are copied in leaf order
+* with their original indexes, which is what the queries return.
+*
+* The build splits all nodes of a level in parallel, and the batched
+* queries spread over the threads of the pool.
+*/
+class KDTree {
+  public:
+    KDTree(ThreadPool &pool);
+
+    void build(const ScanPoint *points, size_t count);
+    void build(const Vector3 *positions, size_t count);
+
+    /*
+    * k nearest points, nearest first, with their squared distances
+    * k is at most KDTREE_MAX_K
+    * Returns how many were found, fewer than k only in a small tree
+    */
+    size_t knn(const Vector3 &query, size_t k, uint32_t *indices, float *distances);
+    /*
+    * k nearest points of each query, k entries per query in indices and
+    * distances, missing ones are KDTREE_NONE
+    */
+    void knn(const Vector3 *queries, size_t count, size_t k, uint32_t *indices, float *distances);
+    /*
+    * Points within radius, in no particular order
+    */
+    size_t radius(const Vector3 &query, float radius, std::vector<uint32_t> &indices);
+    /*
+    * Points within radius of each query, those of query i are
+    * indices[offsets[i]] to indices[offsets[i + 1] - 1]
+    */
+    void radius(const Vector3 *queries, size_t count, float radius, std::vector<uint32_t> &offsets,
+      std::vector<uint32_t> &indices);
+
+    /*
+    * Points within radius, counting stops at limit
+    */
+    size_t count(const Vector3 &query, float radius, size_t limit);
+
+    size_t size(void);
+    /*
+    * Original index of the i-th point in leaf order, neighbours in space
+    * are close in that order, so queries made in it share cached nodes
+    */
+    uint32_t get_index(size_t i);
+
+  private:
+    struct Entry {
+      Vector3 position;
+      uint32_t index;
+    };
+    struct Node {
+      float split;
+      // 0 to 2, or LEAF
+      uint32_t axis;
+      uint32_t begin, end;
+    };
+
+    ThreadPool &_pool;
+    std::vector<Entry> _entries;
+    std::vector<Node> _nodes;
+
+    void split(uint32_t node);
+};
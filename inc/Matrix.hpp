@@ -0,0 +1,194 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+
+#include "Geometry.hpp"
+
+/*
+* Dense row-major matrix with its size fixed at compile time, stored inline
+* so filters using it never allocate
+*/
+template <size_t R, size_t C>
+struct Matrix {
+  float m[R][C];
+
+  static Matrix zeros(void) {
+    Matrix result;
+    for(size_t i = 0; i < R; ++i) {
+      for(size_t j = 0; j < C; ++j) {
+        result.m[i][j] = 0;
+      }
+    }
+    return result;
+  }
+  static Matrix identity(void) {
+    Matrix result = zeros();
+    for(size_t i = 0; i < R && i < C; ++i) {
+      result.m[i][i] = 1;
+    }
+    return result;
+  }
+
+  float &operator()(size_t r, size_t c) {
+    return m[r][c];
+  }
+  float operator()(size_t r, size_t c) const {
+    return m[r][c];
+  }
+
+  Matrix operator+(const Matrix &b) const {
+    Matrix result;
+    for(size_t i = 0; i < R; ++i) {
+      for(size_t j = 0; j < C; ++j) {
+        result.m[i][j] = m[i][j] + b.m[i][j];
+      }
+    }
+    return result;
+  }
+  Matrix operator-(const Matrix &b) const {
+    Matrix result;
+    for(size_t i = 0; i < R; ++i) {
+      for(size_t j = 0; j < C; ++j) {
+        result.m[i][j] = m[i][j] - b.m[i][j];
+      }
+    }
+    return result;
+  }
+  Matrix operator*(float s) const {
+    Matrix result;
+    for(size_t i = 0; i < R; ++i) {
+      for(size_t j = 0; j < C; ++j) {
+        result.m[i][j] = m[i][j]*s;
+      }
+    }
+    return result;
+  }
+  template <size_t K>
+  Matrix<R, K> operator*(const Matrix<C, K> &b) const {
+    Matrix<R, K> result = Matrix<R, K>::zeros();
+    for(size_t i = 0; i < R; ++i) {
+      for(size_t k = 0; k < C; ++k) {
+        float a = m[i][k];
+        if(a == 0) {
+          continue;
+        }
+        for(size_t j = 0; j < K; ++j) {
+          result.m[i][j] += a*b.m[k][j];
+        }
+      }
+    }
+    return result;
+  }
+  Matrix<C, R> transpose(void) const {
+    Matrix<C, R> result;
+    for(size_t i = 0; i < R; ++i) {
+      for(size_t j = 0; j < C; ++j) {
+        result.m[j][i] = m[i][j];
+      }
+    }
+    return result;
+  }
+
+  template <size_t BR, size_t BC>
+  Matrix<BR, BC> block(size_t r, size_t c) const {
+    Matrix<BR, BC> result;
+    for(size_t i = 0; i < BR; ++i) {
+      for(size_t j = 0; j < BC; ++j) {
+        result.m[i][j] = m[r + i][c + j];
+      }
+    }
+    return result;
+  }
+  template <size_t BR, size_t BC>
+  void set_block(size_t r, size_t c, const Matrix<BR, BC> &b) {
+    for(size_t i = 0; i < BR; ++i) {
+      for(size_t j = 0; j < BC; ++j) {
+        m[r + i][c + j] = b.m[i][j];
+      }
+    }
+  }
+};
+
+/*
+* Inverse by Gauss-Jordan elimination with partial pivoting
+* Returns false if the matrix is singular
+*/
+template <size_t N>
+bool invert(const Matrix<N, N> &a, Matrix<N, N> &inverse) {
+  Matrix<N, N> work = a;
+  inverse = Matrix<N, N>::identity();
+
+  for(size_t col = 0; col < N; ++col) {
+    size_t pivot = col;
+    for(size_t row = col + 1; row < N; ++row) {
+      if(std::fabs(work.m[row][col]) > std::fabs(work.m[pivot][col])) {
+        pivot = row;
+      }
+    }
+    if(std::fabs(work.m[pivot][col]) < 1e-12f) {
+      return false;
+    }
+    if(pivot != col) {
+      for(size_t j = 0; j < N; ++j) {
+        float t = work.m[col][j]; work.m[col][j] = work.m[pivot][j]; work.m[pivot][j] = t;
+        t = inverse.m[col][j]; inverse.m[col][j] = inverse.m[pivot][j]; inverse.m[pivot][j] = t;
+      }
+    }
+
+    float scale = 1/work.m[col][col];
+    for(size_t j = 0; j < N; ++j) {
+      work.m[col][j] *= scale;
+      inverse.m[col][j] *= scale;
+    }
+    for(size_t row = 0; row < N; ++row) {
+      float factor = work.m[row][col];
+      if(row == col || factor == 0) {
+        continue;
+      }
+      for(size_t j = 0; j < N; ++j) {
+        work.m[row][j] -= factor*work.m[col][j];
+        inverse.m[row][j] -= factor*inverse.m[col][j];
+      }
+    }
+  }
+
+  return true;
+}
+
+typedef Matrix<3, 3> Matrix3;
+
+/*
+* Cross product matrix, skew(a)*b = a x b
+*/
+inline Matrix3 skew(const Vector3 &v) {
+  Matrix3 result = {{
+    {0, -v.z, v.y},
+    {v.z, 0, -v.x},
+    {-v.y, v.x, 0}
+  }};
+  return result;
+}
+
+/*
+* Rotation matrix of a unit quaternion, body to earth
+*/
+inline Matrix3 rotation_matrix(const Quaternion &q) {
+  float xx = q.x*q.x, yy = q.y*q.y, zz = q.z*q.z;
+  float xy = q.x*q.y, xz = q.x*q.z, yz = q.y*q.z;
+  float wx = q.w*q.x, wy = q.w*q.y, wz = q.w*q.z;
+  Matrix3 result = {{
+    {1 - 2*(yy + zz), 2*(xy - wz), 2*(xz + wy)},
+    {2*(xy + wz), 1 - 2*(xx + zz), 2*(yz - wx)},
+    {2*(xz - wy), 2*(yz + wx), 1 - 2*(xx + yy)}
+  }};
+  return result;
+}
+
+inline Vector3 operator*(const Matrix3 &a, const Vector3 &v) {
+  return {
+    a.m[0][0]*v.x + a.m[0][1]*v.y + a.m[0][2]*v.z,
+    a.m[1][0]*v.x + a.m[1][1]*v.y + a.m[1][2]*v.z,
+    a.m[2][0]*v.x + a.m[2][1]*v.y + a.m[2][2]*v.z
+  };
+}
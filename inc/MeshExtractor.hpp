@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Geometry.hpp"
+#include "TSDFVolume.hpp"
+#include "ThreadPool.hpp"
+
+/*
+* Indexed triangle mesh, triangles are 3 vertex indexes each, counter
+* clockwise seen from the front of the surface
+*/
+struct Mesh {
+  std::vector<Vector3> vertices;
+  std::vector<uint32_t> triangles;
+};
+
+/*
+* Marching cubes over the allocated blocks of a TSDF volume.
+*
+* The cubes between voxel centres of a block, including those reaching
+* into its +x, +y and +z neighbours, are meshed on their own, blocks in
+* parallel. A block is meshed again only when it or one of those
+* neighbours changed since, so periodic meshing during a scan only costs
+* the part being scanned. Cubes with a voxel below the minimum weight,
+* never or barely observed, are left out.
+*
+* Each vertex is keyed by the voxel edge it lies on, so the vertices
+* blocks share on their borders are merged when the block meshes are
+* assembled into one indexed mesh.
+*
+* The cube cases are built at startup from the sign of the corners on each
+* face, separating the inside corners on ambiguous faces, which neighbour
+* cubes agree on, so the surface has no cracks.
+* Not to be run while the volume integrates.
+*/
+class MeshExtractor {
+  public:
+    MeshExtractor(TSDFVolume &volume, ThreadPool &pool);
+
+    bool set_min_weight(float weight);
+
+    /*
+    * Re-mesh the blocks that changed
+    * Returns how many were meshed
+    */
+    size_t update(void);
+    /*
+    * Update, then assemble the whole mesh
+    */
+    void extract(Mesh &mesh);
+
+    static bool write_ply(const std::string &path, const Mesh &mesh);
+    static bool write_stl(const std::string &path, const Mesh &mesh);
+
+  private:
+    struct BlockMesh {
+      // Pass of the volume the block was meshed at
+      uint32_t pass;
+      std::vector<Vector3> vertices;
+      // Voxel edge of each vertex
+      std::vector<uint64_t> keys;
+      std::vector<uint32_t> triangles;
+    };
+
+    TSDFVolume &_volume;
+    ThreadPool &_pool;
+    float _min_weight;
+    std::vector<BlockMesh> _meshes;
+    // Vertex of each edge of the block being meshed, per thread
+    std::vector<std::vector<int32_t>> _edge_vertices;
+
+    bool changed(size_t block);
+    void mesh_block(size_t block, std::vector<int32_t> &edge_vertices);
+};
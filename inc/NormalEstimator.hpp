@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Geometry.hpp"
+#include "KDTree.hpp"
+#include "RangeProjector.hpp"
+#include "ThreadPool.hpp"
+
+/*
+* Surface normals and curvature by principal component analysis: the
+* normal of a point is the direction of least spread of its k nearest
+* neighbours, the smallest eigenvector of their covariance, turned toward
+* the sensor that measured the point. The curvature is the share of that
+* smallest eigenvalue in their sum, 0 on a plane and up to 1/3 for
+* scattered points.
+*
+* Neighbours along a line, as a single beam gives along one sweep, don't
+* fix the surface around it: such a point gets the direction across the
+* line toward the sensor. Points whose neighbours spread evenly in every
+* direction, or are seen along their line, get a zero normal.
+*/
+class NormalEstimator {
+  public:
+    NormalEstimator(ThreadPool &pool);
+
+    /*
+    * Neighbours per point, up to KDTREE_MAX_K
+    */
+    bool set_neighbours(size_t k);
+
+    /*
+    * Normals of points, with the tree built over the same points
+    * curvature may be null
+    */
+    void estimate(KDTree &tree, const ScanPoint *points, size_t count, Vector3 *normals, float *curvature);
+
+  private:
+    ThreadPool &_pool;
+    size_t _k;
+};
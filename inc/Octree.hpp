@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Geometry.hpp"
+#include "RangeProjector.hpp"
+
+// Points a leaf holds before splitting
+#define OCTREE_LEAF_CAPACITY 32
+
+/*
+* Summary of the points below a node
+*/
+struct OctreeNode {
+  // Index of the first of 8 consecutive children, OCTREE_NONE for a leaf
+  uint32_t children;
+  // First point of a leaf, the others are chained through the point links
+  uint32_t head;
+  uint32_t count;
+  // Means of the points
+  Vector3 position;
+  Vector3 origin;
+  float signal_rate;
+  // Bounding box of the points
+  Vector3 min, max;
+  uint64_t newest;
+};
+
+#define OCTREE_NONE UINT32_MAX
+
+/*
+* Octree over the growing point cloud, extended point by point.
+*
+* Nodes come from a pool in groups of 8 siblings and points from another,
+* both only growing, so inserting never frees or moves anything the
+* queries rely on besides reallocating the pools. A leaf splits once it
+* holds more than OCTREE_LEAF_CAPACITY points, unless it's already down to
+* the minimum size, and the root doubles toward points outside of it.
+*
+* Every node keeps the count, means and bounds of its points, which give
+* the level of detail queries their representative of a node and let
+* counts over a box stop at nodes inside it.
+*/
+class Octree {
+  public:
+    /*
+    * Initial cube, it grows as needed
+    * Nodes smaller than min_size don't split
+    */
+    Octree(const Vector3 &center = {0, 0, 0}, float half_size = 4.0f, float min_size = 0.01f);
+
+    void insert(const ScanPoint *points, size_t count);
+    void clear(void);
+
+    /*
+    * Append the points inside the box
+    */
+    size_t query(const Vector3 &min, const Vector3 &max, std::vector<ScanPoint> &points);
+    /*
+    * Append about one point per spacing-sized cell inside the box: a node
+    * no larger than spacing gives the mean of its points, with sensor 0 and
+    * its newest timestamp, larger leaves give their points
+    */
+    size_t query(const Vector3 &min, const Vector3 &max, float spacing, std::vector<ScanPoint> &points);
+    /*
+    * Points inside the box
+    */
+    size_t count(const Vector3 &min, const Vector3 &max);
+
+    size_t get_point_count(void);
+    size_t get_node_count(void);
+    const OctreeNode &get_root(void);
+
+  private:
+    struct Cell {
+      uint32_t node;
+      Vector3 center;
+      float half;
+    };
+
+    std::vector<OctreeNode> _nodes;
+    std::vector<ScanPoint> _points;
+    std::vector<uint32_t> _links;
+    uint32_t _root;
+    Vector3 _center;
+    float _half;
+    float _min_size;
+
+    // Traversal stack of the queries
+    std::vector<Cell> _stack;
+
+    void grow(const Vector3 &p);
+    uint32_t allocate_children(void);
+    void add(OctreeNode &node, const ScanPoint &point);
+    void split(uint32_t node, const Vector3 &center);
+    size_t collect(const Vector3 &min, const Vector3 &max, float spacing, std::vector<ScanPoint> &points);
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "KDTree.hpp"
+#include "RangeProjector.hpp"
+#include "ThreadPool.hpp"
+
+/*
+* Removes the flyers the VL53L0X produces at depth edges and on dark or
+* specular surfaces, with up to three tests in a row:
+*   signal: points returned with less than a minimum signal rate are
+*   dropped up front and don't support the others as neighbours
+*   statistical: points whose mean distance to their k nearest neighbours
+*   is more than sigma standard deviations above the mean of all points
+*   radius: points with fewer than min_neighbours others within radius
+* Each test runs in parallel over a k-d tree of the points still kept.
+*/
+class OutlierFilter {
+  public:
+    OutlierFilter(ThreadPool &pool);
+
+    /*
+    * k of 0 turns the test off
+    */
+    bool set_statistical(size_t k, float sigma);
+    /*
+    * min_neighbours of 0 turns the test off
+    */
+    bool set_radius(float radius, size_t min_neighbours);
+    /*
+    * Signal rate in MCPS, 0 turns the test off
+    */
+    bool set_min_signal_rate(float signal_rate);
+
+    /*
+    * Flag the points to keep
+    * Returns how many are kept
+    */
+    size_t filter(const ScanPoint *points, size_t count, uint8_t *keep);
+    /*
+    * Remove the outliers, keeping the order of the others
+    */
+    size_t filter(std::vector<ScanPoint> &points);
+
+  private:
+    ThreadPool &_pool;
+    KDTree _tree;
+    size_t _k;
+    float _sigma;
+    float _radius;
+    size_t _min_neighbours;
+    float _min_signal_rate;
+
+    /*
+    * Points still kept, and the tree over them
+    */
+    void gather(const ScanPoint *points, size_t count, const uint8_t *keep, std::vector<uint32_t> &kept);
+    void statistical(const ScanPoint *points, const std::vector<uint32_t> &kept, uint8_t *keep);
+    void radius(const ScanPoint *points, const std::vector<uint32_t> &kept, uint8_t *keep);
+};
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "RangeProjector.hpp"
+
+// Alignment of the buffers, and of their size, for O_DIRECT
+#define POINT_CLOUD_ALIGNMENT 4096
+
+enum PointCloudFormat {
+  FORMAT_PLY,
+  FORMAT_PCD
+};
+
+enum PointCloudSync {
+  // Leave it to the kernel
+  SYNC_NONE,
+  // fdatasync once the file is complete
+  SYNC_ON_CLOSE,
+  // fdatasync after every flush, a crash loses at most the buffers in flight
+  SYNC_EVERY_FLUSH
+};
+
+/*
+* Streams points to a binary little endian PLY or PCD file while the scan is
+* running. Points are written as x, y, z and intensity (the signal rate), all
+* 32 bit floats.
+*
+* Points are packed into large aligned buffers, full buffers go to a writer
+* thread that flushes all pending ones with a single writev, so the thread
+* adding points only waits when every buffer is still in flight. The header
+* is written with a fixed width point count that is patched on close.
+* With direct, the file is opened with O_DIRECT so hour-long scans don't fill
+* the page cache, falling back to buffered writes if the filesystem
+* doesn't support it.
+*/
+class PointCloudWriter {
+  public:
+    PointCloudWriter();
+    ~PointCloudWriter();
+
+    /*
+    * Create the file and write its header
+    * buffer_size is rounded up to a multiple of POINT_CLOUD_ALIGNMENT
+    */
+    bool open(const std::string &path, PointCloudFormat format, bool direct = false,
+      PointCloudSync sync = SYNC_ON_CLOSE, size_t buffer_size = 1 << 20, size_t buffers = 4);
+    /*
+    * Append points, false once a write failed
+    */
+    bool write(const ScanPoint *points, size_t count);
+    /*
+    * Flush everything, patch the point count in the header and close
+    */
+    bool close(void);
+
+    uint64_t get_points_written(void);
+    bool is_open(void);
+
+  private:
+    int _fd;
+    PointCloudFormat _format;
+    PointCloudSync _sync;
+    bool _direct;
+
+    size_t _buffer_size;
+    std::vector<uint8_t *> _buffers;
+    // Buffer being filled and how much of it is used
+    uint8_t *_current;
+    size_t _used;
+
+    // Buffers handed over to the writer thread with their lengths, and free ones
+    std::deque<std::pair<uint8_t *, size_t>> _full;
+    std::vector<uint8_t *> _free;
+    std::mutex _mutex;
+    std::condition_variable _full_ready, _free_ready;
+    std::thread _thread;
+    bool _stopping;
+    std::atomic<bool> _failed;
+
+    uint64_t _points;
+    // Where the fixed width counts sit in the header
+    std::vector<size_t> _count_offsets;
+
+    void write_header(void);
+    /*
+    * Hand the current buffer to the writer thread and take a free one
+    */
+    void submit(void);
+    void run(void);
+    bool write_all(int fd, const void *data, size_t length);
+};
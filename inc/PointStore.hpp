@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Geometry.hpp"
+#include "RangeProjector.hpp"
+
+// Default points per chunk, about 2.5MB
+#define POINT_STORE_CHUNK_POINTS 65536
+
+// Room for the file header, chunks start at the next page boundary
+#define POINT_STORE_HEADER_SIZE 4096
+
+/*
+* Layout of a point store file:
+*   PointStoreHeader, padded to first_chunk
+*   chunks of chunk_size bytes each: a PointStoreChunk followed by up to
+*   chunk_points ScanPoints, stored as they are in memory
+*   the index, one PointStoreIndexEntry per chunk
+*   PointStoreFooter
+* Files are read back on the same kind of machine they are written on, the
+* header carries the byte order and point size to reject the others.
+*/
+struct PointStoreHeader {
+  char magic[8];
+  uint32_t byte_order;
+  uint32_t version;
+  uint32_t point_size;
+  uint32_t chunk_points;
+  uint64_t chunk_size;
+  uint64_t first_chunk;
+};
+
+struct PointStoreChunk {
+  uint32_t magic;
+  uint32_t count;
+  // Bounding box of the points
+  Vector3 min, max;
+  // Time range of the points, CLOCK_MONOTONIC in microseconds
+  uint64_t time_min, time_max;
+  uint8_t reserved[16];
+};
+
+struct PointStoreIndexEntry {
+  uint64_t offset;
+  PointStoreChunk chunk;
+};
+
+struct PointStoreFooter {
+  uint64_t index_offset;
+  uint64_t chunks;
+  uint64_t points;
+  char magic[8];
+};
+
+/*
+* Appends points to a store file during a scan, so it never has to be held
+* in memory. Each chunk is filled through its own mmap window, its header
+* is written once it is full and the index and footer on close. If the
+* scan is interrupted, only the chunk being filled is lost: the reader
+* rebuilds the index from the chunk headers.
+*/
+class PointStoreWriter {
+  public:
+    PointStoreWriter();
+    ~PointStoreWriter();
+
+    bool open(const std::string &path, uint32_t chunk_points = POINT_STORE_CHUNK_POINTS);
+    bool append(const ScanPoint *points, size_t count);
+    /*
+    * Complete the last chunk and write the index
+    */
+    bool close(void);
+
+    uint64_t get_points_written(void);
+
+  private:
+    int _fd;
+    uint32_t _chunk_points;
+    uint64_t _chunk_size;
+    // Where the next chunk goes
+    uint64_t _end;
+
+    // Window of the chunk being filled
+    uint8_t *_window;
+    PointStoreChunk _chunk;
+
+    std::vector<PointStoreIndexEntry> _index;
+    uint64_t _points;
+
+    bool map_chunk(void);
+    bool unmap_chunk(void);
+};
+
+/*
+* Maps a store file read only, any chunk is a pointer away. Queries pick
+* the chunks by their bounds and time range before looking at any point.
+*/
+class PointStoreReader {
+  public:
+    PointStoreReader();
+    ~PointStoreReader();
+
+    bool open(const std::string &path);
+    void close(void);
+
+    size_t get_chunk_count(void);
+    uint64_t get_point_count(void);
+    /*
+    * Whether the index was rebuilt because the footer was missing
+    */
+    bool is_recovered(void);
+
+    const PointStoreChunk &get_chunk(size_t chunk);
+    const ScanPoint *get_points(size_t chunk);
+
+    /*
+    * Chunks that may hold points inside the box and the time range
+    */
+    size_t find_chunks(const Vector3 &min, const Vector3 &max, uint64_t time_min, uint64_t time_max,
+      std::vector<size_t> &chunks);
+    /*
+    * Append the points inside the box and the time range
+    * Returns how many were appended
+    */
+    size_t query(const Vector3 &min, const Vector3 &max, uint64_t time_min, uint64_t time_max,
+      std::vector<ScanPoint> &points);
+
+  private:
+    const uint8_t *_map;
+    size_t _size;
+    std::vector<PointStoreIndexEntry> _index;
+    uint64_t _points;
+    bool _recovered;
+
+    bool load_index(void);
+    bool check_index(const PointStoreHeader &header, uint64_t points);
+    void recover_index(const PointStoreHeader &header);
+};
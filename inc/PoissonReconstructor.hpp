@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "Geometry.hpp"
+#include "MeshExtractor.hpp"
+#include "RangeProjector.hpp"
+#include "ThreadPool.hpp"
+
+/*
+* Screened Poisson surface reconstruction (Kazhdan and Hoppe, 2013) of a
+* watertight mesh from oriented points.
+*
+* The indicator function is solved for at the nodes of a regular grid with
+* 2^depth cells along the largest side of the cloud, restricted to 8x8x8
+* node blocks, so memory follows the surface area at the depth asked for.
+* Its gradient is fitted to the normals splatted onto the nodes, with a
+* zero gradient across the border of the blocks, while the screening term
+* pins its value at the points to the iso level, each point weighted by
+* its confidence from the signal rate. The sparse system is solved by
+* conjugate gradients with a Jacobi preconditioner, every product and sum
+* split over the threads of the pool.
+*
+* A dense level 8 times coarser, at most 64 cells across, is solved first
+* over the whole cloud. It tells inside from outside everywhere and,
+* interpolated onto the fine nodes, is where the fine solve starts. The fine
+* blocks are those around the points and those its surface crosses, so
+* the holes of a partial scan are filled as well, and an open scan is
+* closed a few coarse cells past the cloud. The fine solution
+* shifted by the iso level goes into a TSDF volume with a skin of blocks
+* around it holding the sign of the coarse level, so every cube along the
+* border has a single sign and the marching cubes of MeshExtractor give a
+* closed mesh.
+*/
+class PoissonReconstructor {
+  public:
+    PoissonReconstructor(ThreadPool &pool);
+
+    /*
+    * Grid resolution, 2^depth cells along the largest side of the cloud,
+    * from 3 to 10
+    */
+    bool set_depth(int depth);
+    /*
+    * Weight of the interpolation of the points against the fit of the
+    * normals
+    */
+    bool set_screening(float alpha);
+    /*
+    * Signal rate in MCPS at and above which a point gets full confidence
+    */
+    bool set_signal_reference(float signal_rate);
+    bool set_solver(size_t max_iterations, float tolerance);
+
+    /*
+    * Reconstruct from points and their normals, e.g. from NormalEstimator
+    * Returns false if there is nothing to reconstruct or a level didn't
+    * reach the solver tolerance within its iterations, see get_residual()
+    */
+    bool reconstruct(const ScanPoint *points, const Vector3 *normals, size_t count, Mesh &mesh);
+
+    /*
+    * Nodes of the fine level, iterations and relative residual of the last
+    * level solved, the coarse one if reconstruct() stopped there
+    */
+    size_t get_nodes(void);
+    size_t get_iterations(void);
+    float get_residual(void);
+
+  private:
+    struct Block {
+      int32_t x, y, z;
+      // Index of the blocks around, (dx + 1) + 3*((dy + 1) + 3*(dz + 1))
+      uint32_t neighbours[27];
+    };
+
+    struct Level {
+      float cell;
+      std::vector<Block> blocks;
+      std::unordered_map<uint64_t, uint32_t> block_indexes;
+
+      // Per node
+      std::vector<float> chi, rhs, diagonal;
+      // Index of the screening row of each node among screening, 27
+      // coefficients each, for the nodes sharing a cell with a point
+      std::vector<uint32_t> screening_rows;
+      std::vector<float> screening;
+      float iso;
+    };
+
+    ThreadPool &_pool;
+    int _depth;
+    float _alpha;
+    float _signal_reference;
+    size_t _max_iterations;
+    float _tolerance;
+
+    Level _coarse, _fine;
+    size_t _iterations;
+    float _residual;
+
+    void build_dense(Level &level, const Vector3 &min, const Vector3 &max);
+    void build_blocks(Level &level, const ScanPoint *points, size_t count);
+    void add_crossings(int ratio);
+    void link_blocks(Level &level);
+    bool solve_level(Level &level, const Level *coarse, const ScanPoint *points, const Vector3 *normals,
+      size_t count);
+    void prolong(const Level &coarse, Level &level);
+    void build_system(Level &level, const ScanPoint *points, const Vector3 *normals, size_t count);
+    void solve(Level &level);
+    float iso_level(Level &level, const ScanPoint *points, size_t count);
+
+    bool add_block(Level &level, int32_t x, int32_t y, int32_t z);
+    uint32_t node_at(const Level &level, int32_t x, int32_t y, int32_t z);
+    uint32_t neighbour(const Level &level, uint32_t node, int dx, int dy, int dz);
+    /*
+    * Side of the coarse level a fine block is on, -1 inside or 1 outside
+    */
+    float coarse_side(int32_t x, int32_t y, int32_t z, int ratio);
+    float confidence(const ScanPoint &point);
+    /*
+    * The 8 nodes around a point and their trilinear weights
+    */
+    void corners(const Level &level, const Vector3 &p, uint32_t nodes[8], float weights[8]);
+    void multiply(const Level &level, const std::vector<float> &x, std::vector<float> &y);
+    double dot(const std::vector<float> &a, const std::vector<float> &b);
+};
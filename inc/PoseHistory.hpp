@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "Geometry.hpp"
+#include "RingBuffer.hpp"
+
+// Poses kept, about 8s at 500Hz, must be a power of two
+#define POSE_HISTORY_CAPACITY 4096
+
+// Queries interpolated together by the batch lookup
+#define POSE_HISTORY_BATCH 64
+
+struct Pose {
+  // CLOCK_MONOTONIC in microseconds
+  uint64_t timestamp;
+  // Body to earth
+  Quaternion orientation;
+  Vector3 position;
+};
+
+/*
+* Fixed-capacity history of the estimated poses, indexed by time.
+* One thread (the estimator) appends poses in increasing time order while
+* any number of threads look up the pose at arbitrary times in between.
+* Readers never block the writer: each slot carries a sequence number and a
+* read of a slot being overwritten is detected and retried or reported as
+* out of range.
+*
+* Poses arrive at a nearly constant rate, so the bracket of a query time is
+* found by guessing its index from the mean period and correcting by a step
+* or two, which is constant time.
+*/
+class PoseHistory {
+  static_assert((POSE_HISTORY_CAPACITY & (POSE_HISTORY_CAPACITY - 1)) == 0,
+    "PoseHistory capacity must be a power of two");
+
+  public:
+    PoseHistory();
+
+    /*
+    * Writer side, add the newest pose
+    * Returns false if its timestamp isn't after the previous one
+    */
+    bool append(const Pose &pose);
+
+    /*
+    * Pose at time t, interpolated between the two poses around it
+    * Spherical interpolation if slerp, otherwise normalized linear
+    * interpolation, which is cheaper and close enough between poses a few
+    * milliseconds apart.
+    * Returns false if t is outside the history
+    */
+    bool interpolate(uint64_t t, Pose &pose, bool slerp = true);
+    /*
+    * Poses at count times, faster if the times are sorted
+    * Times outside the history get a pose with timestamp 0
+    * Returns how many poses were interpolated
+    */
+    size_t interpolate(const uint64_t *times, size_t count, Pose *poses, bool slerp = true);
+
+    /*
+    * Time span currently held, false if fewer than two poses
+    */
+    bool get_range(uint64_t &oldest, uint64_t &newest);
+    size_t size(void);
+    void clear(void);
+
+  private:
+    struct Slot {
+      // 2*index + 1 while being written, 2*index + 2 once written
+      std::atomic<uint64_t> sequence;
+      Pose pose;
+    };
+
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> _head;
+    alignas(CACHE_LINE_SIZE) Slot _slots[POSE_HISTORY_CAPACITY];
+
+    /*
+    * Copy the pose of an absolute index, false if it was overwritten
+    */
+    bool read(uint64_t index, Pose &pose);
+    /*
+    * Find the poses before and after t, starting the search at hint if t
+    * is within two periods of it, and leave the index of before in hint
+    * Returns false if t is out of the history
+    */
+    bool bracket(uint64_t t, uint64_t &hint, Pose &before, Pose &after);
+};
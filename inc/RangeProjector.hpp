@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Geometry.hpp"
+#include "PoseHistory.hpp"
+#include "StreamMerger.hpp"
+
+// Ranging sensors an extrinsic can be set for
+#define RANGE_PROJECTOR_MAX_SENSORS 8
+
+// Records projected together, a multiple of the vector width
+#define RANGE_PROJECTOR_BATCH 64
+
+// Ranges kept waiting for their pose, about a second of four sensors
+#define RANGE_PROJECTOR_MAX_PENDING 1024
+
+/*
+* One measured point of the surface in the earth frame
+*/
+struct ScanPoint {
+  Vector3 position;
+  // Where the ray started, the sensor at the time of the measurement
+  Vector3 origin;
+  // Return signal rate in MCPS, a measure of confidence
+  float signal_rate;
+  uint8_t sensor;
+  // CLOCK_MONOTONIC in microseconds, the exposure midpoint
+  uint64_t timestamp;
+};
+
+/*
+* Turns ranges into points: each range is placed along its sensor's optical
+* axis, moved into the body frame by the fixed sensor extrinsic and into the
+* earth frame by the scanner pose interpolated at its exposure time.
+*
+* Records go through in batches laid out as arrays per component, and the
+* rigid transforms run four points at a time with the compiler's vector
+* extensions (NEON on ARM, SSE on x86).
+*
+* The estimator runs behind the ranges, so the newest ranges often have no
+* pose after them yet. They are kept and projected by a later call once
+* the poses have caught up.
+*/
+class RangeProjector {
+  public:
+    RangeProjector(PoseHistory &poses);
+
+    /*
+    * Pose of a ranging sensor in the body frame, its optical axis is the z
+    * axis of its own frame
+    */
+    bool set_extrinsic(uint8_t sensor, const Vector3 &origin, const Quaternion &rotation);
+    /*
+    * Project the valid ranges among count events and those left pending
+    * by earlier calls, others are skipped
+    * Points needs room for count + get_pending() points
+    * Returns how many points were written
+    */
+    size_t project(const SensorEvent *events, size_t count, ScanPoint *points);
+    /*
+    * Ranges newer than the newest pose, waiting for the next call
+    */
+    size_t get_pending(void);
+    /*
+    * Ranges dropped because their pose had left the history, or because
+    * too many were pending
+    */
+    uint64_t get_missing_poses(void);
+
+  private:
+    PoseHistory &_poses;
+    Vector3 _origins[RANGE_PROJECTOR_MAX_SENSORS];
+    Vector3 _directions[RANGE_PROJECTOR_MAX_SENSORS];
+    uint64_t _missing_poses;
+    // Ranges waiting for their pose, and those being retried by project()
+    std::vector<SensorEvent> _pending, _retry;
+
+    /*
+    * Project one batch of valid ranges, at most RANGE_PROJECTOR_BATCH
+    */
+    size_t project_batch(const SensorEvent *const *ranges, size_t count, ScanPoint *points);
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Size of a cache line, indices written by different threads are kept apart
+// so the producer and consumer don't invalidate each other's line
+#define CACHE_LINE_SIZE 64
+
+/*
+* Wait-free ring buffer for one producer thread and one consumer thread.
+* Capacity must be a power of two, the buffer holds up to Capacity records.
+* The indices run freely and are masked on access, so a full buffer is told
+* apart from an empty one without wasting a slot.
+*/
+template <typename T, size_t Capacity>
+class RingBuffer {
+  static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+    "RingBuffer capacity must be a power of two");
+
+  public:
+    RingBuffer() : _head(0), _cached_tail(0), _tail(0), _cached_head(0) {}
+
+    /*
+    * Producer side, copy one record in
+    * Returns false without blocking if the buffer is full
+    */
+    bool push(const T &record) {
+      uint64_t head = _head.load(std::memory_order_relaxed);
+      if(head - _cached_tail >= Capacity) {
+        _cached_tail = _tail.load(std::memory_order_acquire);
+        if(head - _cached_tail >= Capacity) {
+          return false;
+        }
+      }
+      _records[head & (Capacity - 1)] = record;
+      _head.store(head + 1, std::memory_order_release);
+      return true;
+    }
+    /*
+    * Consumer side, move up to max_records of the oldest records out
+    * Returns how many were copied
+    */
+    size_t pop(T *records, size_t max_records) {
+      uint64_t tail = _tail.load(std::memory_order_relaxed);
+      if(_cached_head - tail < max_records) {
+        _cached_head = _head.load(std::memory_order_acquire);
+      }
+      size_t count = _cached_head - tail;
+      if(count > max_records) {
+        count = max_records;
+      }
+      for(size_t i = 0; i < count; ++i) {
+        records[i] = _records[(tail + i) & (Capacity - 1)];
+      }
+      _tail.store(tail + count, std::memory_order_release);
+      return count;
+    }
+    /*
+    * Records waiting, exact only when called from the consumer
+    */
+    size_t size(void) {
+      return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+    }
+    constexpr size_t capacity(void) {
+      return Capacity;
+    }
+
+  private:
+    // Written by the producer, with its copy of the consumer index
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> _head;
+    uint64_t _cached_tail;
+    // Written by the consumer, with its copy of the producer index
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> _tail;
+    uint64_t _cached_head;
+
+    alignas(CACHE_LINE_SIZE) T _records[Capacity];
+};
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "RingBuffer.hpp"
+#include "GY_85.hpp"
+#include "VL53L0X_defines.hpp"
+
+enum SensorEventType {
+  EVENT_IMU,
+  EVENT_RANGE
+};
+
+/*
+* One measurement of any sensor of the scanner, for merging into a single
+* time-ordered stream
+*/
+struct SensorEvent {
+  // CLOCK_MONOTONIC in microseconds, for a range its exposure midpoint
+  uint64_t timestamp;
+  SensorEventType type;
+  // Index of the ranging sensor in its array
+  uint8_t sensor;
+  union {
+    GY_85_Sample imu;
+    VL53L0XRangingMeasurement range;
+  };
+};
+
+/*
+* Merges several streams of events, each in time order on its own but
+* arriving with different latencies and in bursts, into one sequence ordered
+* by timestamp.
+*
+* Each stream has its own queue, filled by one producer thread, and declares
+* its latency bound: once its queue is empty, no event older than
+* now - latency is expected from it anymore. An event is emitted as soon as
+* no stream can still deliver an older one, i.e. it isn't newer than the
+* watermark of any stream with an empty queue. A k-way merge over the
+* fronts of the queues, kept in a binary heap, picks the events in order.
+* Events that arrive later than their bound and would break the order are
+* dropped and counted.
+*
+* T needs a uint64_t timestamp member. Streams count from 0 up to Streams - 1
+* and Capacity is the queue length of each stream, a power of two.
+* Everything is preallocated, pop() and flush() must run on one thread.
+*/
+template <typename T, size_t Streams, size_t Capacity>
+class StreamMerger {
+  public:
+    StreamMerger() : _heap_size(0), _late_events(0), _last_emitted(0) {
+      for(size_t s = 0; s < Streams; ++s) {
+        _latency[s] = 0;
+        _enabled[s] = false;
+        _staged[s] = false;
+        _last_staged[s] = 0;
+      }
+    }
+
+    /*
+    * Take part in the merge with a latency bound in microseconds, the
+    * longest delay between an event's timestamp and its push()
+    * Only enabled streams hold back the merge, call before pushing
+    */
+    void enable(size_t stream, uint64_t max_latency) {
+      _latency[stream] = max_latency;
+      _enabled[stream] = true;
+    }
+    /*
+    * Stop waiting for a stream that went quiet, its queued events still go out
+    */
+    void disable(size_t stream) {
+      _enabled[stream] = false;
+    }
+    /*
+    * Producer side of one stream, false if its queue is full
+    */
+    bool push(size_t stream, const T &event) {
+      return _queues[stream].push(event);
+    }
+    /*
+    * Move up to max_events events that can no longer be preceded by another
+    * into events, in time order
+    * Returns how many were moved
+    */
+    size_t pop(uint64_t now, T *events, size_t max_events) {
+      return merge(now, false, events, max_events);
+    }
+    /*
+    * Move out everything queued, in time order, without waiting for late
+    * events, e.g. at the end of a scan
+    */
+    size_t flush(T *events, size_t max_events) {
+      return merge(0, true, events, max_events);
+    }
+    /*
+    * Events dropped because they arrived after newer ones had been emitted
+    */
+    uint64_t get_late_events(void) {
+      return _late_events;
+    }
+
+  private:
+    RingBuffer<T, Capacity> _queues[Streams];
+    uint64_t _latency[Streams];
+    bool _enabled[Streams];
+
+    // Front event of each stream taken out of its queue, and the heap of
+    // the streams with a front, ordered by the front's timestamp
+    T _fronts[Streams];
+    bool _staged[Streams];
+    uint64_t _last_staged[Streams];
+    size_t _heap[Streams];
+    size_t _heap_size;
+
+    uint64_t _late_events;
+    uint64_t _last_emitted;
+
+    size_t merge(uint64_t now, bool flush, T *events, size_t max_events) {
+      for(size_t s = 0; s < Streams; ++s) {
+        stage(s);
+      }
+
+      size_t count = 0;
+      while(count < max_events && _heap_size > 0) {
+        size_t stream = _heap[0];
+        uint64_t timestamp = _fronts[stream].timestamp;
+        if(!flush && timestamp > watermark(now)) {
+          break;
+        }
+
+        events[count++] = _fronts[stream];
+        _last_emitted = timestamp;
+        _staged[stream] = false;
+        remove_top();
+        stage(stream);
+      }
+
+      return count;
+    }
+
+    /*
+    * Oldest timestamp a stream with an empty queue may still deliver
+    */
+    uint64_t watermark(uint64_t now) {
+      uint64_t limit = UINT64_MAX;
+      for(size_t s = 0; s < Streams; ++s) {
+        if(!_enabled[s] || _staged[s]) {
+          continue;
+        }
+        uint64_t bound = now > _latency[s] ? now - _latency[s] : 0;
+        if(_last_staged[s] > bound) {
+          bound = _last_staged[s];
+        }
+        if(bound < limit) {
+          limit = bound;
+        }
+      }
+      return limit;
+    }
+
+    /*
+    * Take the next in-order event of a stream out of its queue into the heap
+    */
+    void stage(size_t stream) {
+      T event;
+      while(!_staged[stream] && _queues[stream].pop(&event, 1) == 1) {
+        if(event.timestamp < _last_emitted) {
+          ++_late_events;
+          continue;
+        }
+        _fronts[stream] = event;
+        _staged[stream] = true;
+        _last_staged[stream] = event.timestamp;
+        insert(stream);
+      }
+    }
+
+    bool earlier(size_t a, size_t b) {
+      return _fronts[_heap[a]].timestamp < _fronts[_heap[b]].timestamp;
+    }
+    void swap(size_t a, size_t b) {
+      size_t t = _heap[a];
+      _heap[a] = _heap[b];
+      _heap[b] = t;
+    }
+    void insert(size_t stream) {
+      size_t i = _heap_size++;
+      _heap[i] = stream;
+      while(i > 0 && earlier(i, (i - 1)/2)) {
+        swap(i, (i - 1)/2);
+        i = (i - 1)/2;
+      }
+    }
+    void remove_top(void) {
+      _heap[0] = _heap[--_heap_size];
+      size_t i = 0;
+      while(true) {
+        size_t smallest = i, left = 2*i + 1, right = 2*i + 2;
+        if(left < _heap_size && earlier(left, smallest)) {
+          smallest = left;
+        }
+        if(right < _heap_size && earlier(right, smallest)) {
+          smallest = right;
+        }
+        if(smallest == i) {
+          break;
+        }
+        swap(i, smallest);
+        i = smallest;
+      }
+    }
+};
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "Geometry.hpp"
+#include "RangeProjector.hpp"
+#include "ThreadPool.hpp"
+
+// Voxels along each edge of a block
+#define TSDF_BLOCK_SIZE 8
+#define TSDF_BLOCK_VOXELS (TSDF_BLOCK_SIZE*TSDF_BLOCK_SIZE*TSDF_BLOCK_SIZE)
+
+// Shares of the blocks the updates are applied by, each on one thread
+#define TSDF_SHARDS 64
+
+struct TSDFVoxel {
+  // Signed distance to the surface in meters, positive in front of it
+  float sdf;
+  // Zero for a voxel never observed
+  float weight;
+};
+
+/*
+* Voxels x + 8*(y + 8*z) of the block at block coordinates x, y, z, which
+* covers voxel coordinates 8*x to 8*x + 7 and so on
+*/
+struct TSDFBlock {
+  int32_t x, y, z;
+  // Integration pass that last changed the block
+  uint32_t updated;
+  TSDFVoxel voxels[TSDF_BLOCK_VOXELS];
+};
+
+/*
+* Truncated signed distance field fused from single ranges.
+*
+* Space is divided into blocks of 8x8x8 voxels allocated the first time a
+* ray gets near them, found through an open addressing hash of their
+* coordinates, so memory is only spent close to the surfaces.
+* Each range updates the voxels its ray crosses within the truncation band
+* around the measured point with a running weighted average. The weight
+* grows with the signal rate, since weak returns are the noisy ones, and
+* fades behind the surface. The band widens with the range to cover the
+* few percent of ranging noise.
+*
+* A batch of rays is traced on all threads of the pool, each range of rays
+* sorting its updates by the share of the blocks they fall in. The blocks
+* are then allocated on the calling thread and each share is applied by one
+* thread, so no voxel is locked. A voxel gets its updates in the order of
+* the rays whatever the number of threads, and so the same value.
+*/
+class TSDFVolume {
+  public:
+    TSDFVolume(ThreadPool &pool, float voxel_size = 0.01f, float truncation = 0.03f);
+
+    /*
+    * Signal rate in MCPS at and above which a range gets the full weight
+    */
+    bool set_signal_reference(float signal_rate);
+    /*
+    * Weight at which voxels stop accumulating, so they keep following a
+    * changing scene
+    */
+    bool set_max_weight(float max_weight);
+    /*
+    * Ranging noise relative to the range, widens the band past truncation
+    */
+    bool set_range_noise(float relative);
+
+    void integrate(const ScanPoint *points, size_t count);
+    /*
+    * Overwrite the voxels of a block, allocating it, to mesh a field
+    * computed elsewhere, counts as a pass
+    */
+    void set_block(int32_t x, int32_t y, int32_t z, const TSDFVoxel *voxels);
+    /*
+    * Drop every block
+    */
+    void clear(void);
+
+    /*
+    * Voxel containing p, false if its block isn't allocated
+    */
+    bool get_voxel(const Vector3 &p, TSDFVoxel &voxel);
+    const TSDFBlock *find_block(int32_t x, int32_t y, int32_t z);
+    size_t get_block_count(void);
+    const TSDFBlock &get_block(size_t block);
+    float get_voxel_size(void);
+    /*
+    * Integration passes and block writes so far, compared with
+    * TSDFBlock::updated to find what changed
+    */
+    uint32_t get_pass(void);
+
+  private:
+    struct Update {
+      uint64_t key;
+      uint32_t block;
+      uint16_t voxel;
+      float sdf;
+      float weight;
+    };
+
+    // Updates of a range of rays, by shard
+    struct Chunk {
+      std::vector<Update> updates;
+      uint32_t offsets[TSDF_SHARDS + 1];
+    };
+
+    ThreadPool &_pool;
+    float _voxel_size;
+    float _truncation;
+    float _signal_reference;
+    float _max_weight;
+    float _range_noise;
+    uint32_t _pass;
+
+    // Blocks don't move once allocated
+    std::deque<TSDFBlock> _blocks;
+    // Open addressing from block keys to indexes in _blocks
+    std::vector<uint64_t> _keys;
+    std::vector<uint32_t> _slots;
+    size_t _mask;
+
+    // Per range of traced rays
+    std::vector<Chunk> _chunks;
+    // Per thread, updates of a range before they are sorted
+    std::vector<std::vector<Update>> _scratch;
+
+    void trace(const ScanPoint &point, std::vector<Update> &updates);
+    uint32_t find(uint64_t key);
+    uint32_t allocate(uint64_t key);
+    void grow(void);
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+* Fixed set of worker threads running data parallel loops for the point
+* cloud and surface processing stages. The calling thread takes part in
+* each loop, as thread 0, and returns once every index was processed.
+*
+* Indexes are handed out in ranges of grain from a shared counter, so
+* uneven work balances itself. Loops can't be nested, and only one thread
+* at a time may start them.
+*/
+class ThreadPool {
+  public:
+    /*
+    * Threads counts the caller, 0 for one per core
+    */
+    ThreadPool(size_t threads = 0);
+    ~ThreadPool();
+
+    /*
+    * Threads taking part in a loop, the caller included
+    */
+    size_t size(void);
+
+    /*
+    * Call body(begin, end, thread) over ranges covering 0 to count - 1
+    * thread is below size(), for per-thread scratch space
+    */
+    void parallel_for(size_t count, const std::function<void(size_t, size_t, size_t)> &body,
+      size_t grain = 1);
+
+  private:
+    std::vector<std::thread> _threads;
+    std::mutex _mutex;
+    std::condition_variable _start, _done;
+    bool _stopping;
+    uint64_t _generation;
+    size_t _running;
+
+    const std::function<void(size_t, size_t, size_t)> *_body;
+    size_t _count, _grain;
+    std::atomic<size_t> _next;
+
+    void run(size_t thread);
+    void work(size_t thread);
+};
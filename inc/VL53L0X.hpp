@@ -6,9 +6,12 @@
 #ifndef _VL53L0X_H
 #define _VL53L0X_H
 
+#include <cmath>
 #include <cstdint>
 #include <fstream>
+#include <functional>
 #include <mutex>
+#include <string>
 
 #include "I2C.hpp"
 #include "VL53L0X_defines.hpp"
@@ -37,12 +40,39 @@ class VL53L0X {
 		 * It's not part of the constructor as it can throw errors.
 		 */
 		void initialize();
+		/**
+		 * Same as initialize(), but restores the sensor's calibration from a cache file when one exists.
+		 *
+		 * \param calibrationCacheDirectory - directory holding one cache file per sensor, named after the sensor's unique ID.
+		 * \param temperatureCelsius - current temperature (e.g. from the ITG-3205). If it differs from the cached one by more than 8 degC
+		 * the reference calibration is performed again. NAN skips the check.
+		 *
+		 * On a cache hit SPAD info readout, timing budget computation and reference calibration are skipped and the stored values are written back instead;
+		 * on a miss the full sequence runs and its result is cached for the next start.
+		 * Returns true if the cache was used.
+		 */
+		bool initialize(const std::string &calibrationCacheDirectory, float temperatureCelsius = NAN);
+		/**
+		 * Get the per-device state resulting from the last initialization.
+		 */
+		inline VL53L0XCalibration getCalibration() {
+			return this->calibration;
+		}
+		/**
+		 * Write the default tuning settings, in one combined transaction if batched, otherwise one register write at a time.
+		 *
+		 * Part of initialization; public so both ways can be timed against each other.
+		 * Based on VL53L0X_load_tuning_settings().
+		 */
+		void loadTuningSettings(bool batched = true);
 		/**
 		 * Power on the sensor by setting its XSHUT pin to high via host's GPIO.
 		 */
 		void powerOn();
 		/**
 		 * Power off the sensor by setting its XSHUT pin to low via host's GPIO.
+		 *
+		 * The sensor comes back at the default address, so the address kept by this object is reset as well.
 		 */
 		void powerOff();
 		/**
@@ -107,6 +137,18 @@ class VL53L0X {
 		 * Based on VL53L0X_StartMeasurement().
 		 */
 		void startContinuous(uint32_t periodMilliseconds = 0);
+		/**
+		 * Set the inter-measurement period of continuous timed mode in oscillator ticks (OSC_CALIBRATE_VAL ticks make one millisecond).
+		 *
+		 * Finer than the milliseconds taken by startContinuous(), meant to trim the period while ranging; the new period applies from the next measurement.
+		 */
+		void setInterMeasurementPeriodTicks(uint32_t ticks);
+		/**
+		 * Get the inter-measurement period in oscillator ticks as last set, 0 if continuous timed mode was never started.
+		 */
+		inline uint32_t getInterMeasurementPeriodTicks() {
+			return this->interMeasurementPeriodTicks;
+		}
 		/**
 		 * Stop continuous measurements.
 		 *
@@ -127,6 +169,56 @@ class VL53L0X {
 		 * Based on VL53L0X_PerformSingleRangingMeasurement().
 		 */
 		uint16_t readRangeSingleMillimeters();
+		/**
+		 * Same as readRangeContinuousMillimeters(), but returns the whole result: range, range status, effective SPAD count, signal and ambient rates.
+		 * Warning: Blocking call!
+		 *
+		 * Returns false on timeout.
+		 */
+		bool readRangeContinuous(VL53L0XRangingMeasurement* measurement);
+		/**
+		 * Same as readRangeSingleMillimeters(), but returns the whole result.
+		 * Warning: Blocking call!
+		 *
+		 * Returns false on timeout.
+		 */
+		bool readRangeSingle(VL53L0XRangingMeasurement* measurement);
+		/**
+		 * Start a single-shot range measurement and return immediately.
+		 *
+		 * Non-blocking counterpart of readRangeSingleMillimeters(); completion is picked up with tryGetResult().
+		 */
+		void startRange();
+		/**
+		 * Check for a finished measurement without blocking.
+		 *
+		 * Interrupt status and range result are fetched in one combined I2C transaction (register write, repeated start, 13-byte read),
+		 * so a poll that finds nothing costs one system call. Returns false without touching the sensor if the transfer fails.
+		 * If a measurement is ready, stores it in rangeMillimeters, clears the interrupt, invokes the range callback (if set) and returns true.
+		 * Works after startRange() as well as in continuous mode.
+		 */
+		bool tryGetResult(uint16_t* rangeMillimeters);
+		/**
+		 * Same as tryGetResult(uint16_t*), but returns the whole result decoded from the same burst read.
+		 *
+		 * The exposure window of the measurement is estimated from the time the result was flagged and the duration of the ranging steps.
+		 * If the GPIO1 interrupt is monitored, pass the time of its edge (CLOCK_MONOTONIC, microseconds) as interruptMicroseconds;
+		 * otherwise (0) the time is bracketed between the last poll that found nothing and this one.
+		 */
+		bool tryGetResult(VL53L0XRangingMeasurement* measurement, uint64_t interruptMicroseconds = 0);
+		/**
+		 * Whether a measurement started with startRange() has not been collected yet.
+		 */
+		inline bool isRangePending() {
+			return this->rangePending;
+		}
+		/**
+		 * Set a callback invoked by tryGetResult() with every completed measurement, e.g. to dispatch results from an event loop.
+		 * Pass an empty function to remove it.
+		 */
+		inline void setRangeCallback(std::function<void(const VL53L0XRangingMeasurement&)> callback) {
+			this->rangeCallback = callback;
+		}
 		/**
 		 * Set value of timeout for measurements.
 		 * 0 (dafault value) means no time limit for measurements (infinite wait).
@@ -160,6 +252,18 @@ class VL53L0X {
 		bool didTimeout;
 		// read by init and used when starting measurement; is StopVariable field of VL53L0X_DevData_t structure in API
 		uint8_t stopVariable;
+		// SYSTEM_INTERMEASUREMENT_PERIOD as last written
+		uint32_t interMeasurementPeriodTicks;
+		// duration of the pre-range and final range steps, updated along with the timing budget
+		uint32_t rangingStepsMicroseconds;
+		// when the last measurement was started and the last poll that found no result, to bracket completion times
+		uint64_t rangeStartMicroseconds;
+		uint64_t lastEmptyPollMicroseconds;
+		// set by startRange(), cleared when tryGetResult() collects the measurement
+		bool rangePending;
+		std::function<void(const VL53L0XRangingMeasurement&)> rangeCallback;
+		// state captured during initialization, see getCalibration()
+		VL53L0XCalibration calibration;
 
 		I2C &_i2c;
 
@@ -167,12 +271,62 @@ class VL53L0X {
 
 		void initHardware();
 		void initGPIO();
+		/**
+		 * Based on VL53L0X_DataInit(), without reading the stop variable.
+		 */
+		void dataInit();
+		/**
+		 * Read the stop variable used when starting measurements. Part of VL53L0X_DataInit().
+		 */
+		void readStopVariable();
+		/**
+		 * Based on VL53L0X_StaticInit().
+		 *
+		 * If cached is given, its reference SPAD map and timing configuration are written back instead of being read from NVM and recomputed.
+		 */
+		void staticInit(const VL53L0XCalibration* cached);
+		/**
+		 * Perform VHV and phase calibration.
+		 *
+		 * Based on VL53L0X_PerformRefCalibration().
+		 */
+		void performRefCalibration();
 		/**
 		 * Get reference SPAD (single photon avalanche diode) count and type.
 		 *
 		 * Based on VL53L0X_get_info_from_device(), but only gets reference SPAD count and type.
 		 */
 		bool getSPADInfo(uint8_t* count, bool* typeIsAperture);
+		/**
+		 * Get the unique part ID stored in NVM.
+		 *
+		 * Based on VL53L0X_get_info_from_device(), but only gets PartUIDUpper and PartUIDLower.
+		 */
+		bool getUniqueID(uint64_t* uid);
+		/**
+		 * Enter and leave the register page giving access to the NVM.
+		 */
+		void beginNVMAccess();
+		void endNVMAccess();
+		/**
+		 * Based on VL53L0X_device_read_strobe().
+		 */
+		bool strobeNVMRead();
+		/**
+		 * Get and set VHV settings and phase calibration.
+		 *
+		 * Based on VL53L0X_get_ref_calibration() and VL53L0X_set_ref_calibration().
+		 */
+		void getRefCalibration(uint8_t* vhvSettings, uint8_t* phaseCal);
+		void setRefCalibration(uint8_t vhvSettings, uint8_t phaseCal);
+		/**
+		 * Read a calibration cache file, only succeeds if it belongs to the sensor with the given unique ID.
+		 */
+		static bool loadCalibration(const std::string &filename, uint64_t uid, VL53L0XCalibration* calibration);
+		/**
+		 * Write the current calibration to a cache file.
+		 */
+		bool saveCalibration(const std::string &filename);
 		/**
 		 * Get sequence step enables.
 		 *
@@ -185,6 +339,16 @@ class VL53L0X {
 		 * Based on get_sequence_step_timeout(), but gets all timeouts instead of just the requested one, and also stores intermediate values.
 		 */
 		void getSequenceStepTimeouts(const VL53L0XSequenceStepEnables* enables, VL53L0XSequenceStepTimeouts* timeouts);
+		/**
+		 * Fill in the exposure window of a measurement read at readMicroseconds, see tryGetResult().
+		 */
+		void timestampMeasurement(VL53L0XRangingMeasurement* measurement, uint64_t readMicroseconds, uint64_t interruptMicroseconds);
+		/**
+		 * Decode the 12-byte RESULT_RANGE_STATUS block.
+		 *
+		 * Based on VL53L0X_GetRangingMeasurementData().
+		 */
+		static void decodeRangingMeasurement(const uint8_t* block, VL53L0XRangingMeasurement* measurement);
 		/**
 		 * Decode sequence step timeout in MCLKs from register value.
 		 *
@@ -236,6 +400,12 @@ class VL53L0X {
 		 * Write an arbitrary number of bytes from the given array to the sensor, starting at the given register.
 		 */
 		void writeRegisterMultiple(uint8_t register, const uint8_t* source, uint8_t count);
+		/**
+		 * Write a table of {register, value} pairs in a single combined bus transaction.
+		 *
+		 * Pairs are written in order; consecutive registers are merged into bursts, writes to 0xFF (page select) are kept on their own.
+		 */
+		void writeRegisterTable(const uint8_t (*table)[2], size_t length);
 		/**
 		 * Read an 8-bit register.
 		 */
@@ -0,0 +1,103 @@
+#ifndef _VL53L0X_ARRAY_H
+#define _VL53L0X_ARRAY_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "I2C.hpp"
+#include "VL53L0X.hpp"
+
+/**
+ * Several VL53L0X sensors sharing one I2C bus.
+ *
+ * All sensors power up at the default address, so each one needs its own XSHUT line:
+ * the array keeps every sensor in hardware standby, wakes them one at a time and moves each to its own address
+ * before the next one is released.
+ */
+class VL53L0XArray {
+	public:
+		/*** Constructors and destructors ***/
+
+		/**
+		 * \param xshutGPIOPins - host's GPIO pin wired to the XSHUT of each sensor, one entry per sensor.
+		 * \param firstAddress - address given to the first sensor, the following ones get consecutive addresses.
+		 * \param ioMode2v8 - whether to configure the sensors for 2V8 mode.
+		 *
+		 * The addresses firstAddress to firstAddress + N - 1 must be free on the bus (mind the GY-85 at 0x1E, 0x53 and 0x68)
+		 * and must not include the sensors' default address.
+		 */
+		VL53L0XArray(I2C &i2c, const std::vector<int16_t> &xshutGPIOPins, uint8_t firstAddress = 0x30, bool ioMode2v8 = true);
+
+		/*** Public methods ***/
+
+		/**
+		 * Hold all sensors in reset, wake them one by one assigning each its address,
+		 * then run the hardware initialization of all sensors in parallel.
+		 *
+		 * Initialization is mostly waiting on calibrations, so running it concurrently on the shared bus
+		 * takes about as long as initializing a single sensor.
+		 * Throws the first error raised by any of the sensors.
+		 */
+		void initialize();
+		/**
+		 * Same as initialize(), restoring each sensor's calibration from its file in calibrationCacheDirectory when possible,
+		 * see VL53L0X::initialize(const std::string&, float).
+		 */
+		void initialize(const std::string &calibrationCacheDirectory, float temperatureCelsius = NAN);
+		/**
+		 * Start continuous timed ranging on all sensors with the given inter-measurement period,
+		 * staggering the starts by periodMilliseconds / N so results are spread evenly over the period instead of arriving in a burst.
+		 *
+		 * The timing budget of every sensor must fit in periodMilliseconds.
+		 */
+		void startStaggered(uint32_t periodMilliseconds);
+		/**
+		 * Stop continuous ranging on all sensors.
+		 */
+		void stopContinuous();
+		/**
+		 * Collect every finished measurement without blocking, calling callback(sensorIndex, measurement) for each one.
+		 *
+		 * Returns how many measurements were collected.
+		 */
+		size_t poll(std::function<void(size_t, const VL53L0XRangingMeasurement&)> callback);
+		/**
+		 * Power off all sensors. They have to go through initialize() again afterwards.
+		 */
+		void powerOff();
+		/**
+		 * Number of sensors in the array.
+		 */
+		inline size_t size() {
+			return this->sensors.size();
+		}
+		/**
+		 * Access a single sensor, e.g. to change its timing budget after initialize().
+		 */
+		inline VL53L0X& operator[](size_t index) {
+			return *this->sensors[index];
+		}
+	private:
+		/*** Private fields ***/
+
+		std::vector<std::unique_ptr<VL53L0X>> sensors;
+		uint8_t firstAddress;
+
+		/*** Private methods ***/
+
+		/**
+		 * Hold every sensor in reset, then wake and readdress them one at a time.
+		 */
+		void assignAddresses();
+		/**
+		 * Run initializer on every sensor concurrently, rethrowing the first error.
+		 */
+		void initializeConcurrently(std::function<void(VL53L0X&)> initializer);
+
+		I2C &_i2c;
+};
+
+#endif
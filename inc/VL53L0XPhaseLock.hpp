@@ -0,0 +1,87 @@
+#ifndef _VL53L0X_PHASE_LOCK_H
+#define _VL53L0X_PHASE_LOCK_H
+
+#include <cstdint>
+
+#include "VL53L0X.hpp"
+
+// Timestamps kept to estimate each clock's period
+#define PHASE_LOCK_WINDOW 32
+
+/**
+ * Keeps the ranges of a sensor in continuous timed mode at a fixed phase of the IMU sample clock.
+ *
+ * The sensor's oscillator and the IMU output data rate drift relative to each other, so the phase between
+ * ranges and IMU samples wanders. Both clocks are observed through host timestamps: the rate of each is estimated
+ * over a window of samples, and every few ranges the inter-measurement period is trimmed so that each range
+ * lands at the requested fraction of an IMU sample period, with exactly imuSamplesPerRange IMU samples in between.
+ *
+ * The sensor must already be ranging in continuous timed mode (VL53L0X::startContinuous() with a period).
+ */
+class VL53L0XPhaseLock {
+	public:
+		/*** Constructors and destructors ***/
+
+		/**
+		 * \param imuSamplesPerRange - IMU sample periods per range period.
+		 * \param phase - wanted position of the ranges within an IMU sample period, 0 (on a sample) to 1.
+		 * \param trimEveryRanges - how often the period is trimmed; the phase error is averaged in between.
+		 */
+		VL53L0XPhaseLock(VL53L0X &sensor, uint32_t imuSamplesPerRange, float phase = 0, uint32_t trimEveryRanges = 4);
+
+		/*** Public methods ***/
+
+		/**
+		 * Feed the timestamp of an IMU sample (CLOCK_MONOTONIC, microseconds).
+		 */
+		void addImuSample(uint64_t timestampMicroseconds);
+		/**
+		 * Feed the timestamp of a range, ideally its exposure midpoint (CLOCK_MONOTONIC, microseconds).
+		 *
+		 * Returns true if the inter-measurement period was trimmed.
+		 */
+		bool addRange(uint64_t timestampMicroseconds);
+		/**
+		 * Whether enough samples were seen to estimate both clocks.
+		 */
+		bool isLocked();
+		/**
+		 * Last measured offset of the ranges from the wanted phase, in microseconds (positive: ranges late).
+		 */
+		inline float getPhaseError() {
+			return this->phaseErrorMicroseconds;
+		}
+		/**
+		 * Estimated IMU sample period in microseconds of host time.
+		 */
+		float getImuPeriod();
+		/**
+		 * Estimated sensor oscillator rate in ticks per microsecond of host time.
+		 */
+		inline float getOscillatorRate() {
+			return this->ticksPerMicrosecond;
+		}
+	private:
+		/*** Private fields ***/
+
+		VL53L0X &sensor;
+		uint32_t imuSamplesPerRange;
+		float phase;
+		uint32_t trimEveryRanges;
+
+		// ring buffers of the latest IMU sample and range timestamps
+		uint64_t imuTimestamps[PHASE_LOCK_WINDOW];
+		uint32_t imuCount;
+		uint64_t rangeTimestamps[PHASE_LOCK_WINDOW];
+		// period in ticks the sensor used for the interval ending at the range with the same index
+		uint32_t rangeTicks[PHASE_LOCK_WINDOW];
+		uint32_t rangeCount;
+
+		float ticksPerMicrosecond;
+		float phaseErrorMicroseconds;
+		float phaseErrorSum;
+		float phaseErrorIntegral;
+		uint32_t rangesSinceTrim;
+};
+
+#endif
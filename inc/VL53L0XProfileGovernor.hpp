@@ -0,0 +1,92 @@
+#ifndef _VL53L0X_PROFILE_GOVERNOR_H
+#define _VL53L0X_PROFILE_GOVERNOR_H
+
+#include <cstdint>
+
+#include "VL53L0X.hpp"
+#include "VL53L0X_defines.hpp"
+
+/**
+ * Switches a sensor between ranging profiles at runtime so the spacing between points on the surface stays roughly constant.
+ *
+ * While the scanner sweeps at angular rate w over a target at range r, one measurement with timing budget T
+ * smears over w * r * T millimeters of surface. The governor picks the slowest (most accurate) profile that keeps
+ * this below the target spacing: high speed during fast sweeps, high accuracy when the operator dwells on detail,
+ * and long range for far or weak targets when there is time for it.
+ *
+ * Profile changes reprogram the sensor, so update() must be called between measurements
+ * (single-shot ranging, or with continuous ranging stopped).
+ */
+class VL53L0XProfileGovernor {
+	public:
+		/*** Constructors and destructors ***/
+
+		/**
+		 * \param sensor - initialized sensor, switched to the default profile. Its current settings are read back first so only differences are ever written.
+		 * \param targetSpacingMillimeters - wanted distance between consecutive points on the surface.
+		 */
+		VL53L0XProfileGovernor(VL53L0X &sensor, float targetSpacingMillimeters);
+
+		/*** Public methods ***/
+
+		/**
+		 * Pick the profile for the next measurement.
+		 *
+		 * \param angularRateDegreesPerSecond - magnitude of the gyroscope angular rate.
+		 * \param last - previous measurement, its range, status and signal rate are used.
+		 *
+		 * Returns true if the profile was changed.
+		 */
+		bool update(float angularRateDegreesPerSecond, const VL53L0XRangingMeasurement &last);
+		/**
+		 * Force the given profile, writing only the settings that differ from the current ones.
+		 */
+		bool setProfile(vl53l0xRangingProfile profile);
+		/**
+		 * Get the profile in use.
+		 */
+		inline vl53l0xRangingProfile getProfile() {
+			return this->profile;
+		}
+		/**
+		 * Settings used by each profile.
+		 */
+		static const VL53L0XProfileSettings& getProfileSettings(vl53l0xRangingProfile profile);
+		/**
+		 * Set the distance between consecutive points on the surface the governor aims for.
+		 */
+		inline void setTargetSpacing(float targetSpacingMillimeters) {
+			this->targetSpacingMillimeters = targetSpacingMillimeters;
+		}
+		/**
+		 * Ranges beyond this (or targets returning less signal than minSignalRateMCPS) call for the long range profile.
+		 * Defaults to 1200 mm and 1 MCPS.
+		 */
+		inline void setLongRangeThresholds(uint16_t rangeMillimeters, float minSignalRateMCPS) {
+			this->longRangeMillimeters = rangeMillimeters;
+			this->longRangeSignalRateMCPS = minSignalRateMCPS;
+		}
+	private:
+		/*** Private fields ***/
+
+		VL53L0X &sensor;
+		vl53l0xRangingProfile profile;
+		// what is currently programmed in the sensor
+		VL53L0XProfileSettings current;
+
+		float targetSpacingMillimeters;
+		uint16_t longRangeMillimeters;
+		float longRangeSignalRateMCPS;
+		// last valid range, used while the sensor reports no target
+		uint16_t lastRangeMillimeters;
+
+		// profile requested by the previous updates and how many times in a row, to avoid flapping
+		vl53l0xRangingProfile candidate;
+		uint8_t candidateCount;
+
+		/*** Private methods ***/
+
+		vl53l0xRangingProfile choose(float angularRateDegreesPerSecond, const VL53L0XRangingMeasurement &last);
+};
+
+#endif
@@ -98,6 +98,54 @@ enum vl53l0xVcselPeriodType {
 	VcselPeriodFinalRange
 };
 
+/**
+ * Ranging profiles from the API user manual (UM2039)
+ */
+enum vl53l0xRangingProfile {
+	ProfileDefault,
+	ProfileHighAccuracy,
+	ProfileLongRange,
+	ProfileHighSpeed
+};
+
+struct VL53L0XProfileSettings {
+	uint32_t measurementTimingBudgetMicroseconds;
+	float signalRateLimitMCPS;
+	uint8_t preRangeVcselPeriodPCLKs;
+	uint8_t finalRangeVcselPeriodPCLKs;
+};
+
+/**
+ * Range status as reported by VL53L0X_get_pal_range_status() (same values)
+ */
+enum vl53l0xRangeStatus {
+	RangeValid = 0,
+	RangeSignalFail = 2,
+	RangeMinRangeFail = 3,
+	RangePhaseFail = 4,
+	RangeHardwareFail = 5,
+	// No (meaningful) measurement, e.g. target out of range
+	RangeNone = 255
+};
+
+/**
+ * One measurement decoded from the RESULT_RANGE_STATUS block
+ */
+struct VL53L0XRangingMeasurement {
+	uint16_t rangeMillimeters;
+	// Effective number of return SPADs, 8.8 fixed point
+	uint16_t effectiveSPADReturnCount;
+	float signalRateMCPS;
+	float ambientRateMCPS;
+	// Raw device status (bits 6:3 of RESULT_RANGE_STATUS) and its interpretation
+	uint8_t deviceRangeStatus;
+	vl53l0xRangeStatus rangeStatus;
+	// Estimated exposure window (CLOCK_MONOTONIC, microseconds): the ranging steps integrate photons over [start, end]
+	uint64_t exposureStartMicroseconds;
+	uint64_t exposureMidMicroseconds;
+	uint64_t exposureEndMicroseconds;
+};
+
 struct VL53L0XSequenceStepEnables {
 	// TCC: Target CentreCheck
 	bool tcc;
@@ -122,4 +170,24 @@ struct VL53L0XSequenceStepTimeouts {
 	uint32_t finalRangeMicroseconds;
 };
 
+/**
+ * Per-device state produced by initialization, enough to bring the sensor back up without recalibrating.
+ */
+struct VL53L0XCalibration {
+	// PartUIDUpper and PartUIDLower from NVM
+	uint64_t uid;
+	// StopVariable field of VL53L0X_DevData_t
+	uint8_t stopVariable;
+	// Reference SPAD enables as written by VL53L0X_set_reference_spads()
+	uint8_t refSPADMap[6];
+	// Results of VL53L0X_perform_ref_calibration()
+	uint8_t vhvSettings;
+	uint8_t phaseCal;
+	// Timing configuration (FINAL_RANGE_CONFIG_TIMEOUT_MACROP register value)
+	uint16_t finalRangeTimeout;
+	uint32_t measurementTimingBudgetMicroseconds;
+	// Temperature at which the reference calibration was performed, NAN if unknown
+	float temperatureCelsius;
+};
+
 #endif
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Geometry.hpp"
+#include "PointStore.hpp"
+#include "RangeProjector.hpp"
+
+// Default number of voxels held, a power of two
+#define VOXEL_FILTER_CAPACITY (1 << 18)
+
+// Points gathered before being appended to the store
+#define VOXEL_FILTER_BATCH 1024
+
+/*
+* Streaming voxel grid downsampling: every voxel of the grid keeps the
+* running mean of the points that fell into it, so a surface swept many
+* times is stored once per voxel.
+*
+* Voxels live in an open addressing hash table keyed by their packed integer
+* coordinates, with linear probing. Voxels not hit for max_age are the ones
+* the scanner moved away from: when the table fills up they are written to
+* the point store as one point each and dropped, so memory stays bounded.
+* A voxel revisited after being dropped starts over and is stored again.
+*/
+class VoxelFilter {
+  public:
+    /*
+    * Capacity is rounded up to a power of two
+    */
+    VoxelFilter(PointStoreWriter &store, size_t capacity = VOXEL_FILTER_CAPACITY);
+
+    /*
+    * Edge length of the voxels in meters, writes out the current grid
+    */
+    bool set_resolution(float resolution);
+    /*
+    * Microseconds a voxel stays in the working set after its last point
+    */
+    bool set_max_age(uint64_t max_age);
+
+    bool insert(const ScanPoint *points, size_t count);
+    /*
+    * Write out every voxel, e.g. at the end of a scan
+    */
+    bool flush(void);
+
+    size_t get_voxels(void);
+    uint64_t get_points_in(void);
+    uint64_t get_points_out(void);
+
+  private:
+    struct Voxel {
+      uint64_t key;
+      uint32_t count;
+      uint8_t sensor;
+      // Running means
+      Vector3 position;
+      Vector3 origin;
+      float signal_rate;
+      uint64_t first_seen, last_seen;
+    };
+
+    PointStoreWriter &_store;
+    std::vector<Voxel> _table, _scratch;
+    size_t _mask;
+    size_t _voxels;
+    float _resolution;
+    uint64_t _max_age;
+    uint64_t _newest;
+
+    ScanPoint _batch[VOXEL_FILTER_BATCH];
+    size_t _batch_size;
+    uint64_t _points_in, _points_out;
+    bool _failed;
+
+    uint64_t key(const Vector3 &p);
+    size_t slot(uint64_t key);
+    /*
+    * Write out the voxels last seen before cutoff, then rehash the others
+    */
+    void evict(uint64_t cutoff);
+    void emit(const Voxel &voxel);
+};
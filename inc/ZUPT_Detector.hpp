@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Geometry.hpp"
+#include "GY_85.hpp"
+
+// Longest window of samples the detector can hold
+#define ZUPT_MAX_WINDOW 128
+
+/*
+* Zero velocity detector, a sliding window generalized likelihood ratio test
+* of stillness (SHOE): the mean over the window of
+*   |a - g*mean(a)/|mean(a)||²/σa² + |w|²/σg²
+* compared against a threshold. At rest each term averages about 3, so with
+* sigmas matching the sensor noise, thresholds of 10 to 30 are typical.
+* The window sums are updated incrementally so each sample costs the same
+* whatever the window length.
+*
+* The accelerometer inactivity event (GY_85::set_inactivity_detection) can
+* seed the detection: after one, the scanner counts as still right away and
+* stays so against a looser threshold until the test shows motion.
+*/
+class ZUPT_Detector {
+  public:
+    /*
+    * Window in samples, noise of one sample in m/s² and rad/s, threshold of
+    * the test statistic
+    */
+    ZUPT_Detector(size_t window = 20, float accel_sigma = 0.05f, float gyros_sigma = 0.01f,
+      float threshold = 20);
+
+    /*
+    * Add a GY_85 sample and return whether the scanner is still
+    * Samples without a new gyroscope reading don't enter the window
+    */
+    bool update(const GY_85_Sample &sample);
+    /*
+    * Add a sample in m/s² and rad/s and return whether the scanner is still
+    */
+    bool update(const Vector3 &accel, const Vector3 &gyros, bool inactive = false);
+
+    bool is_stationary(void);
+    /*
+    * Last value of the test statistic, 0 until the window is full
+    */
+    float get_statistic(void);
+    void set_threshold(float threshold);
+    /*
+    * Gyroscope bias in rad/s removed before the test, e.g. the estimate of
+    * the pose filter, otherwise a biased gyroscope never looks still
+    */
+    void set_gyros_bias(const Vector3 &bias);
+    /*
+    * Use the inactivity event as a seed, with the threshold multiplied by
+    * factor while seeded. Enabled by default with a factor of 2.
+    */
+    void set_inactivity_seed(bool enabled, float factor = 2);
+    void reset(void);
+
+  private:
+    size_t _window;
+    float _inv_accel_var, _inv_gyros_var, _threshold;
+    Vector3 _gyros_bias;
+    bool _seed_enabled;
+    float _seed_factor;
+
+    // Window contents and running sums, in double so the subtraction of old
+    // samples doesn't accumulate rounding
+    Vector3 _accel[ZUPT_MAX_WINDOW];
+    float _gyros_energy[ZUPT_MAX_WINDOW];
+    size_t _count, _next;
+    double _sum_ax, _sum_ay, _sum_az, _sum_a2, _sum_w2;
+
+    float _statistic;
+    bool _stationary, _seeded;
+};
@@ -299,7 +299,7 @@ uint8_t ADXL345::get_active_inactive_ctrl(void) {
  *  @return true if success and false if failure to set new configuration
  */
 bool ADXL345::set_active_inactive_ctrl(uint8_t value) {
-  bool b = this->writeRegister(ADXL345_INACTIVITY_TIME, value);
+  bool b = this->writeRegister(ADXL345_AXIS_EN_CTRL_ACT_INA, value);
   if(b) {
     this->_active_inactive_ctrl = value;
   }
@@ -357,7 +357,7 @@ uint8_t ADXL345::get_axes_tap_ctrl(void) {
  *  @return true if success and false if failure to new configuration
  */
 bool ADXL345::set_axes_tap_ctrl(uint8_t value) {
-  bool b = this->writeRegister(ADXL345_AXIS_EN_CTRL_ACT_INA, value);
+  bool b = this->writeRegister(ADXL345_AXIS_CTRL_SNG_DBL_TAP, value);
   if(b) {
     this->_axes_tap_ctrl = value;
   }
@@ -531,9 +531,20 @@ float ADXL345::get_z_value(void) {
  * @return None
  */
 void ADXL345::get_raw_data(void) {
-  uint16_t data[3];
+  uint8_t data[6];
+
+  readRegister(ADXL345_DATA_X0, data, 6);
 
-  readRegister(ADXL345_DATA_X0, (uint8_t *)&data, 6);
+  parse_raw_data(data);
+}
+
+/** @brief  Convert a burst of the data registers
+ *  @param  6 bytes read from ADXL345_DATA_X0 to ADXL345_DATA_Z1
+ *  @return None
+ */
+void ADXL345::parse_raw_data(const uint8_t *raw) {
+  uint16_t data[3];
+  memcpy(data, raw, sizeof(data));
 
   _gx = ((int16_t)htole16(data[0]))*_scale_factor;
   _gy = ((int16_t)htole16(data[1]))*_scale_factor;
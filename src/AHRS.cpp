@@ -0,0 +1,200 @@
+#include <cmath>
+
+#include "AHRS.hpp"
+
+#define DEGREES_TO_RADIANS 0.017453292519943295f
+
+AHRS::AHRS(AHRS_Algorithm algorithm, float gain_p, float gain_i) {
+  _algorithm = algorithm;
+  set_gains(gain_p, gain_i);
+  reset();
+}
+
+/**
+ * @bref  Integrate one step and correct it with the measured directions
+ * @param Angular rate in rad/s
+ * @param Acceleration, any unit
+ * @param Magnetic field, any unit, zero when not available
+ * @param Step in seconds
+ * @return None
+ */
+void AHRS::update(const Vector3 &gyros, const Vector3 &accel, const Vector3 &magnt, float dt) {
+  if(_algorithm == AHRS_MADGWICK) {
+    madgwick(gyros, accel, magnt, dt);
+  } else {
+    mahony(gyros, accel, magnt, dt);
+  }
+}
+
+/**
+ * @bref  Integrate a batch of samples in order
+ * @param Samples, oldest first
+ * @param How many samples
+ * @return None
+ */
+void AHRS::update(const GY_85_Sample *samples, size_t count) {
+  for(size_t i = 0; i < count; ++i) {
+    const GY_85_Sample &s = samples[i];
+    if(!s.gyros_new) {
+      continue;
+    }
+
+    float dt = (s.timestamp - _timestamp)*1e-6f;
+    bool first = _timestamp == 0 || s.timestamp <= _timestamp || dt > AHRS_MAX_STEP;
+    _timestamp = s.timestamp;
+    if(first) {
+      continue;
+    }
+
+    Vector3 g = {s.gyros.x*DEGREES_TO_RADIANS, s.gyros.y*DEGREES_TO_RADIANS, s.gyros.z*DEGREES_TO_RADIANS};
+    Vector3 a = {s.accel.x, s.accel.y, s.accel.z};
+    Vector3 m = {s.magnt.x, s.magnt.y, s.magnt.z};
+    update(g, a, m, dt);
+  }
+}
+
+Quaternion AHRS::get_quaternion(void) {
+  return _q;
+}
+
+Vector3 AHRS::get_euler(void) {
+  return _q.to_euler();
+}
+
+uint64_t AHRS::get_timestamp(void) {
+  return _timestamp;
+}
+
+void AHRS::set_gains(float gain_p, float gain_i) {
+  _gain_p = gain_p;
+  _gain_i = gain_i;
+}
+
+/**
+ * @bref  Restart from a known orientation
+ * @param Orientation, body to earth
+ * @return None
+ */
+void AHRS::reset(const Quaternion &q) {
+  _q = q;
+  _integral = {0, 0, 0};
+  _timestamp = 0;
+}
+
+/**
+ * @bref  Madgwick step: rate of change from the gyroscope minus beta times
+ *        the normalized gradient of the direction error
+ * @param Angular rate in rad/s
+ * @param Acceleration
+ * @param Magnetic field
+ * @param Step in seconds
+ * @return None
+ */
+void AHRS::madgwick(const Vector3 &g, const Vector3 &a, const Vector3 &m, float dt) {
+  float q0 = _q.w, q1 = _q.x, q2 = _q.y, q3 = _q.z;
+
+  float qdot0 = 0.5f*(-q1*g.x - q2*g.y - q3*g.z);
+  float qdot1 = 0.5f*(q0*g.x + q2*g.z - q3*g.y);
+  float qdot2 = 0.5f*(q0*g.y - q1*g.z + q3*g.x);
+  float qdot3 = 0.5f*(q0*g.z + q1*g.y - q2*g.x);
+
+  float a_norm = a.norm();
+  if(a_norm > 0) {
+    float ax = a.x/a_norm, ay = a.y/a_norm, az = a.z/a_norm;
+    float s0, s1, s2, s3;
+
+    float m_norm = m.norm();
+    if(m_norm > 0) {
+      float mx = m.x/m_norm, my = m.y/m_norm, mz = m.z/m_norm;
+
+      float _2q0mx = 2*q0*mx, _2q0my = 2*q0*my, _2q0mz = 2*q0*mz, _2q1mx = 2*q1*mx;
+      float _2q0 = 2*q0, _2q1 = 2*q1, _2q2 = 2*q2, _2q3 = 2*q3;
+      float _2q0q2 = 2*q0*q2, _2q2q3 = 2*q2*q3;
+      float q0q0 = q0*q0, q0q1 = q0*q1, q0q2 = q0*q2, q0q3 = q0*q3;
+      float q1q1 = q1*q1, q1q2 = q1*q2, q1q3 = q1*q3;
+      float q2q2 = q2*q2, q2q3 = q2*q3, q3q3 = q3*q3;
+
+      // Earth field direction, its horizontal part along x
+      float hx = mx*q0q0 - _2q0my*q3 + _2q0mz*q2 + mx*q1q1 + _2q1*my*q2 + _2q1*mz*q3 - mx*q2q2 - mx*q3q3;
+      float hy = _2q0mx*q3 + my*q0q0 - _2q0mz*q1 + _2q1mx*q2 - my*q1q1 + my*q2q2 + _2q2*mz*q3 - my*q3q3;
+      float _2bx = std::sqrt(hx*hx + hy*hy);
+      float _2bz = -_2q0mx*q2 + _2q0my*q1 + mz*q0q0 + _2q1mx*q3 - mz*q1q1 + _2q2*my*q3 - mz*q2q2 + mz*q3q3;
+      float _4bx = 2*_2bx, _4bz = 2*_2bz;
+
+      // Objective function for gravity and for the field
+      float fax = 2*q1q3 - _2q0q2 - ax;
+      float fay = 2*q0q1 + _2q2q3 - ay;
+      float faz = 1 - 2*q1q1 - 2*q2q2 - az;
+      float fmx = _2bx*(0.5f - q2q2 - q3q3) + _2bz*(q1q3 - q0q2) - mx;
+      float fmy = _2bx*(q1q2 - q0q3) + _2bz*(q0q1 + q2q3) - my;
+      float fmz = _2bx*(q0q2 + q1q3) + _2bz*(0.5f - q1q1 - q2q2) - mz;
+
+      s0 = -_2q2*fax + _2q1*fay - _2bz*q2*fmx + (-_2bx*q3 + _2bz*q1)*fmy + _2bx*q2*fmz;
+      s1 = _2q3*fax + _2q0*fay - 4*q1*faz + _2bz*q3*fmx + (_2bx*q2 + _2bz*q0)*fmy + (_2bx*q3 - _4bz*q1)*fmz;
+      s2 = -_2q0*fax + _2q3*fay - 4*q2*faz + (-_4bx*q2 - _2bz*q0)*fmx + (_2bx*q1 + _2bz*q3)*fmy + (_2bx*q0 - _4bz*q2)*fmz;
+      s3 = _2q1*fax + _2q2*fay + (-_4bx*q3 + _2bz*q1)*fmx + (-_2bx*q0 + _2bz*q2)*fmy + _2bx*q1*fmz;
+    } else {
+      float _2q0 = 2*q0, _2q1 = 2*q1, _2q2 = 2*q2, _2q3 = 2*q3;
+      float _4q0 = 4*q0, _4q1 = 4*q1, _4q2 = 4*q2, _8q1 = 8*q1, _8q2 = 8*q2;
+      float q0q0 = q0*q0, q1q1 = q1*q1, q2q2 = q2*q2, q3q3 = q3*q3;
+
+      s0 = _4q0*q2q2 + _2q2*ax + _4q0*q1q1 - _2q1*ay;
+      s1 = _4q1*q3q3 - _2q3*ax + 4*q0q0*q1 - _2q0*ay - _4q1 + _8q1*q1q1 + _8q1*q2q2 + _4q1*az;
+      s2 = 4*q0q0*q2 + _2q0*ax + _4q2*q3q3 - _2q3*ay - _4q2 + _8q2*q1q1 + _8q2*q2q2 + _4q2*az;
+      s3 = 4*q1q1*q3 - _2q1*ax + 4*q2q2*q3 - _2q2*ay;
+    }
+
+    float s_norm = std::sqrt(s0*s0 + s1*s1 + s2*s2 + s3*s3);
+    if(s_norm > 0) {
+      float step = _gain_p/s_norm;
+      qdot0 -= step*s0;
+      qdot1 -= step*s1;
+      qdot2 -= step*s2;
+      qdot3 -= step*s3;
+    }
+  }
+
+  _q = Quaternion{q0 + qdot0*dt, q1 + qdot1*dt, q2 + qdot2*dt, q3 + qdot3*dt}.normalized();
+}
+
+/**
+ * @bref  Mahony step: the cross product between measured and estimated
+ *        directions is fed back into the angular rate through a PI controller
+ * @param Angular rate in rad/s
+ * @param Acceleration
+ * @param Magnetic field
+ * @param Step in seconds
+ * @return None
+ */
+void AHRS::mahony(const Vector3 &g, const Vector3 &a, const Vector3 &m, float dt) {
+  Vector3 omega = g;
+
+  float a_norm = a.norm();
+  if(a_norm > 0) {
+    Quaternion q_inv = _q.conjugate();
+
+    // Gravity direction expected in the body frame
+    Vector3 v = q_inv.rotate({0, 0, 1});
+    Vector3 error = (a*(1/a_norm)).cross(v);
+
+    float m_norm = m.norm();
+    if(m_norm > 0) {
+      // Field in the earth frame with its horizontal part turned onto x,
+      // then back to the body frame
+      Vector3 mn = m*(1/m_norm);
+      Vector3 h = _q.rotate(mn);
+      Vector3 w = q_inv.rotate({std::sqrt(h.x*h.x + h.y*h.y), 0, h.z});
+      error += mn.cross(w);
+    }
+
+    if(_gain_i > 0) {
+      _integral += error*(_gain_i*dt);
+      omega += _integral;
+    }
+    omega += error*_gain_p;
+  }
+
+  Quaternion dq = _q*Quaternion{0, omega.x, omega.y, omega.z};
+  float h = 0.5f*dt;
+  _q = Quaternion{_q.w + dq.w*h, _q.x + dq.x*h, _q.y + dq.y*h, _q.z + dq.z*h}.normalized();
+}
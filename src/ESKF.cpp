@@ -0,0 +1,246 @@
+#include <cmath>
+
+#include "ESKF.hpp"
+
+#define DEGREES_TO_RADIANS 0.017453292519943295f
+
+// Longest gap integrated as one step, longer ones restart the time
+#define ESKF_MAX_STEP 0.1f
+
+// 99% quantiles of the chi-squared distribution by degrees of freedom
+static const float chi2_gate[] = {0, 6.63f, 9.21f, 11.34f};
+
+ESKF::ESKF(const ESKF_Noise &noise) {
+  _noise = noise;
+  reset(Quaternion::identity());
+}
+
+/**
+ * @bref  Restart at a known pose with the velocity and biases at zero
+ * @param Orientation, body to earth
+ * @param Position in meters
+ * @return None
+ */
+void ESKF::reset(const Quaternion &q, const Vector3 &position) {
+  _p = position;
+  _v = {0, 0, 0};
+  _q = q;
+  _ba = {0, 0, 0};
+  _bg = {0, 0, 0};
+  _timestamp = 0;
+
+  // The starting point defines the origin, the rest is loosely known
+  const float sigmas[ESKF_N] = {
+    0.001f, 0.001f, 0.001f,
+    0.01f, 0.01f, 0.01f,
+    0.1f, 0.1f, 0.1f,
+    0.2f, 0.2f, 0.2f,
+    0.02f, 0.02f, 0.02f
+  };
+  _P = Matrix<ESKF_N, ESKF_N>::zeros();
+  for(size_t i = 0; i < ESKF_N; ++i) {
+    _P(i, i) = sigmas[i]*sigmas[i];
+  }
+}
+
+/**
+ * @bref  Integrate the nominal state and propagate the error covariance
+ * @param Specific force in m/s², body frame
+ * @param Angular rate in rad/s, body frame
+ * @param Step in seconds
+ * @return None
+ */
+void ESKF::predict(const Vector3 &accel, const Vector3 &gyros, float dt) {
+  Vector3 a = accel - _ba;
+  Vector3 w = gyros - _bg;
+  Matrix3 R = rotation_matrix(_q);
+
+  Vector3 a_earth = R*a + Vector3{0, 0, -GRAVITY};
+  _p += _v*dt + a_earth*(0.5f*dt*dt);
+  _v += a_earth*dt;
+  _q = (_q*Quaternion::from_rotation_vector(w*dt)).normalized();
+
+  // First order transition of the error state, I + A*dt
+  Matrix<ESKF_N, ESKF_N> F = Matrix<ESKF_N, ESKF_N>::identity();
+  Matrix3 I_dt = Matrix3::identity()*dt;
+  F.set_block(ESKF_P, ESKF_V, I_dt);
+  F.set_block(ESKF_V, ESKF_THETA, (R*skew(a))*(-dt));
+  F.set_block(ESKF_V, ESKF_BA, R*(-dt));
+  F.set_block(ESKF_THETA, ESKF_THETA, Matrix3::identity() - skew(w)*dt);
+  F.set_block(ESKF_THETA, ESKF_BG, I_dt*(-1));
+
+  _P = F*_P*F.transpose();
+
+  float qv = _noise.accel*dt, qt = _noise.gyros*dt;
+  float qa = _noise.accel_bias*_noise.accel_bias*dt, qg = _noise.gyros_bias*_noise.gyros_bias*dt;
+  for(size_t i = 0; i < 3; ++i) {
+    _P(ESKF_V + i, ESKF_V + i) += qv*qv;
+    _P(ESKF_THETA + i, ESKF_THETA + i) += qt*qt;
+    _P(ESKF_BA + i, ESKF_BA + i) += qa;
+    _P(ESKF_BG + i, ESKF_BG + i) += qg;
+  }
+}
+
+/**
+ * @bref  Propagate with one GY_85 sample, converting its units
+ * @param Sample
+ * @return None
+ */
+void ESKF::predict(const GY_85_Sample &sample) {
+  float dt = (sample.timestamp - _timestamp)*1e-6f;
+  bool first = _timestamp == 0 || sample.timestamp <= _timestamp || dt > ESKF_MAX_STEP;
+  _timestamp = sample.timestamp;
+  if(first) {
+    return;
+  }
+
+  Vector3 accel = {sample.accel.x*GRAVITY, sample.accel.y*GRAVITY, sample.accel.z*GRAVITY};
+  Vector3 gyros = {sample.gyros.x*DEGREES_TO_RADIANS, sample.gyros.y*DEGREES_TO_RADIANS, sample.gyros.z*DEGREES_TO_RADIANS};
+  predict(accel, gyros, dt);
+}
+
+/**
+ * @bref  Zero velocity pseudo-measurement
+ * @param Standard deviation in m/s
+ * @return true if applied or false if rejected
+ */
+bool ESKF::update_zero_velocity(float sigma) {
+  Matrix<3, 1> r = {{{-_v.x}, {-_v.y}, {-_v.z}}};
+  Matrix<3, ESKF_N> H = Matrix<3, ESKF_N>::zeros();
+  H.set_block(0, ESKF_V, Matrix3::identity());
+
+  return update(r, H, Matrix3::identity()*(sigma*sigma));
+}
+
+/**
+ * @bref  Heading measurement from the magnetometer
+ * @param Magnetic field in the body frame
+ * @param Standard deviation in radians
+ * @param Magnetic declination in radians
+ * @return true if applied or false if rejected
+ */
+bool ESKF::update_heading(const Vector3 &magnt, float sigma, float declination) {
+  Matrix3 R = rotation_matrix(_q);
+  Vector3 m = R*magnt;
+  if(m.x*m.x + m.y*m.y < 1e-12f) {
+    return false;
+  }
+
+  // A heading error of the estimate turns the field seen in the earth frame
+  // the other way around z
+  float r = std::atan2(m.y, m.x) - declination;
+  r = std::atan2(std::sin(r), std::cos(r));
+
+  Matrix<1, 1> residual = {{{r}}};
+  Matrix<1, ESKF_N> H = Matrix<1, ESKF_N>::zeros();
+  for(size_t j = 0; j < 3; ++j) {
+    H(0, ESKF_THETA + j) = -R(2, j);
+  }
+
+  return update(residual, H, Matrix<1, 1>{{{sigma*sigma}}});
+}
+
+/**
+ * @bref  Range along a ray to a known plane
+ * @param Measured range in meters
+ * @param Ray origin in the body frame
+ * @param Ray unit direction in the body frame
+ * @param Plane unit normal in the earth frame
+ * @param Plane offset, normal·x = offset
+ * @param Standard deviation in meters
+ * @return true if applied or false if rejected
+ */
+bool ESKF::update_range_to_plane(float range, const Vector3 &origin, const Vector3 &direction,
+  const Vector3 &normal, float offset, float sigma) {
+  Matrix3 R = rotation_matrix(_q);
+  Vector3 s = _p + R*origin;
+  Vector3 u = R*direction;
+
+  // Rays grazing the plane give no usable range
+  float d = normal.dot(u);
+  if(std::fabs(d) < 0.1f) {
+    return false;
+  }
+  float predicted = (offset - normal.dot(s))/d;
+  if(predicted <= 0) {
+    return false;
+  }
+
+  // range = (offset - n·(p + R·o))/(n·R·d), with R·(I + [δθ]x) for the attitude error
+  Matrix<1, 3> n = {{{normal.x, normal.y, normal.z}}};
+  Matrix<1, 3> nR = n*R;
+  Matrix<1, 3> dtheta = (nR*skew(origin) + nR*skew(direction)*predicted)*(1/d);
+
+  Matrix<1, ESKF_N> H = Matrix<1, ESKF_N>::zeros();
+  H.set_block(0, ESKF_P, n*(-1/d));
+  H.set_block(0, ESKF_THETA, dtheta);
+
+  Matrix<1, 1> residual = {{{range - predicted}}};
+  return update(residual, H, Matrix<1, 1>{{{sigma*sigma}}});
+}
+
+Vector3 ESKF::get_position(void) {
+  return _p;
+}
+
+Vector3 ESKF::get_velocity(void) {
+  return _v;
+}
+
+Quaternion ESKF::get_orientation(void) {
+  return _q;
+}
+
+Vector3 ESKF::get_accel_bias(void) {
+  return _ba;
+}
+
+Vector3 ESKF::get_gyros_bias(void) {
+  return _bg;
+}
+
+uint64_t ESKF::get_timestamp(void) {
+  return _timestamp;
+}
+
+const Matrix<ESKF_N, ESKF_N> &ESKF::get_covariance(void) {
+  return _P;
+}
+
+template <size_t M>
+bool ESKF::update(const Matrix<M, 1> &residual, const Matrix<M, ESKF_N> &H, const Matrix<M, M> &R) {
+  Matrix<ESKF_N, M> PHt = _P*H.transpose();
+  Matrix<M, M> S = H*PHt + R;
+  Matrix<M, M> S_inv;
+  if(!invert(S, S_inv)) {
+    return false;
+  }
+
+  // Mahalanobis gate against outliers such as a ray hitting something else
+  float distance = (residual.transpose()*S_inv*residual)(0, 0);
+  if(M < sizeof(chi2_gate)/sizeof(chi2_gate[0]) && distance > chi2_gate[M]) {
+    return false;
+  }
+
+  Matrix<ESKF_N, M> K = PHt*S_inv;
+  inject(K*residual);
+
+  // Joseph form keeps the covariance symmetric and positive
+  Matrix<ESKF_N, ESKF_N> I_KH = Matrix<ESKF_N, ESKF_N>::identity() - K*H;
+  _P = I_KH*_P*I_KH.transpose() + K*R*K.transpose();
+
+  return true;
+}
+
+/**
+ * @bref  Add the estimated error to the nominal state
+ * @param Error state
+ * @return None
+ */
+void ESKF::inject(const Matrix<ESKF_N, 1> &dx) {
+  _p += Vector3{dx(ESKF_P, 0), dx(ESKF_P + 1, 0), dx(ESKF_P + 2, 0)};
+  _v += Vector3{dx(ESKF_V, 0), dx(ESKF_V + 1, 0), dx(ESKF_V + 2, 0)};
+  _q = (_q*Quaternion::from_rotation_vector({dx(ESKF_THETA, 0), dx(ESKF_THETA + 1, 0), dx(ESKF_THETA + 2, 0)})).normalized();
+  _ba += Vector3{dx(ESKF_BA, 0), dx(ESKF_BA + 1, 0), dx(ESKF_BA + 2, 0)};
+  _bg += Vector3{dx(ESKF_BG, 0), dx(ESKF_BG + 1, 0), dx(ESKF_BG + 2, 0)};
+}
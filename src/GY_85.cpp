@@ -0,0 +1,179 @@
+#include <string.h>
+#include <time.h>
+
+#include "GY_85.hpp"
+
+// Output data rates of the magnetometer by data output bits, in mHz
+static const uint32_t compass_rates[] = {750, 1500, 3000, 7500, 15000, 30000, 75000};
+// Data output bits of the magnetometer after reset, 15Hz
+#define COMPASS_RESET_RATE 4
+
+// Gyroscope low pass filter bandwidths by DLPF_CFG, for the 1kHz internal rate
+static const uint16_t gyroscope_bandwidths[] = {0, 188, 98, 42, 20, 10, 5};
+
+static uint64_t monotonic_microseconds(void) {
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec*1000000 + now.tv_nsec/1000;
+}
+
+GY_85::GY_85(I2C &i2c, uint16_t sample_rate) : _i2c(i2c), accelero(i2c),
+  compass(i2c), gyroscope(i2c) {
+  // Until set_sample_rate succeeds the magnetometer runs at its reset rate
+  _compass_period = 1000000000ull/compass_rates[COMPASS_RESET_RATE];
+  _compass_timestamp = 0;
+  memset(_compass_raw, 0, sizeof(_compass_raw));
+
+  accelero.set_data_format(ADXL345_FULL_RES);
+  accelero.set_power_ctrl(ADXL345_MEASURE);
+
+  // PLL with the X gyro as reference is more stable than the internal oscillator
+  gyroscope.set_power_management_configuration(1);
+  // RAW_DATA_RDY is only reported with its interrupt enabled, reading the
+  // status register clears it
+  gyroscope.set_interrupt_configuration(ITG_3205_LATCH_INT_EN + ITG_3205_RAW_RDY_EN);
+
+  compass.set_register_b_configuration(0x20);
+  compass.set_mode_register(0);
+
+  set_sample_rate(sample_rate);
+}
+
+/**
+ * @bref  Set the output data rate of the three sensors
+ * @param Wanted rate in Hz
+ * @return true if success or false if don't
+ */
+bool GY_85::set_sample_rate(uint16_t sample_rate) {
+  if(sample_rate == 0) {
+    return false;
+  }
+
+  // ADXL345: 3200Hz / 2^(15 - code)
+  uint8_t accel_code = 6;
+  while(accel_code < 15 && (3200.0/(1 << (15 - accel_code))) < sample_rate) {
+    ++accel_code;
+  }
+
+  // ITG-3205: 1kHz / (divider + 1), widest filter under the Nyquist frequency
+  uint16_t divider = (1000 + sample_rate/2)/sample_rate;
+  divider = divider < 1 ? 0 : (divider > 256 ? 255 : divider - 1);
+  uint8_t dlpf = 1;
+  while(dlpf < 6 && gyroscope_bandwidths[dlpf] > 500/(divider + 1)) {
+    ++dlpf;
+  }
+
+  uint8_t compass_code = 0;
+  while(compass_code < 6 && compass_rates[compass_code] < sample_rate*1000u) {
+    ++compass_code;
+  }
+
+  bool b = accelero.set_data_rt_power_ctrl(accel_code);
+  b = gyroscope.set_sample_rate_divider(divider) && b;
+  b = gyroscope.set_digital_low_pass_filter_config(dlpf) && b;
+  b = compass.set_register_a_configuration(compass_code << 2) && b;
+  if(b) {
+    _compass_period = 1000000000ull/compass_rates[compass_code];
+  }
+
+  return b;
+}
+
+/**
+ * @bref  Enable the inactivity event of the accelerometer
+ * @param Threshold in mg
+ * @param Time in seconds
+ * @return true if success or false if don't
+ */
+bool GY_85::set_inactivity_detection(uint16_t milli_gs, uint8_t seconds) {
+  bool b = accelero.set_inactive_threshold(milli_gs);
+  b = b && accelero.set_time_inactive(seconds);
+  b = b && accelero.set_active_inactive_ctrl(ADXL345_INACT_AC_DC | ADXL345_INACT_X_EN |
+    ADXL345_INACT_Y_EN | ADXL345_INACT_Z_EN);
+  // Only enabled events are reported in the interrupt source register
+  b = b && accelero.set_interrupt_enable_ctrl(accelero.get_interrupt_enable_ctrl() | ADXL345_INACTIVITY);
+  return b;
+}
+
+/**
+ * @bref  Read the three sensors in one combined transaction
+ * @param Sample to fill
+ * @return true if success or false if don't
+ */
+bool GY_85::read(GY_85_Sample &sample) {
+  // Interrupt source and data format come right before the data, likewise
+  // the gyroscope status and temperature
+  uint8_t accel_register = ADXL345_INTERRUPT_SOURCE;
+  uint8_t gyros_register = ITG_3205_INT_STATUS;
+  uint8_t compass_register = HMC5883_DATA_OUTPUT_X_MSB;
+  uint8_t accel_data[8], gyros_data[9], compass_data[6];
+
+  I2CMessage messages[] = {
+    {ACCELERATOR_ADDR, false, &accel_register, 1},
+    {ACCELERATOR_ADDR, true, accel_data, sizeof(accel_data)},
+    {GYROSCOPE_ADDR, false, &gyros_register, 1},
+    {GYROSCOPE_ADDR, true, gyros_data, sizeof(gyros_data)},
+    {COMPASS_ADDR, false, &compass_register, 1},
+    {COMPASS_ADDR, true, compass_data, sizeof(compass_data)}
+  };
+
+  uint64_t start = monotonic_microseconds();
+  if(!_i2c.transfer(messages, sizeof(messages)/sizeof(messages[0]))) {
+    return false;
+  }
+  sample.timestamp = (start + monotonic_microseconds())/2;
+
+  accelero.parse_raw_data(accel_data + 2);
+  gyroscope.parse_raw_data(gyros_data + 1);
+  compass.parse_raw_data(compass_data);
+
+  sample.accel = {accelero.get_x_value(), accelero.get_y_value(), accelero.get_z_value()};
+  sample.gyros = {gyroscope.get_x_value(), gyroscope.get_y_value(), gyroscope.get_z_value()};
+  sample.magnt = {compass.get_x_value(), compass.get_y_value(), compass.get_z_value()};
+  sample.temperature = gyroscope.get_temperature();
+
+  sample.accel_new = accel_data[0] & ADXL345_DATA_READY;
+  sample.accel_inactive = accel_data[0] & ADXL345_INACTIVITY;
+  sample.gyros_new = gyros_data[0] & ITG_3205_RAW_DATA_RDY;
+
+  // The magnetometer ready bit stays set until the next measurement starts,
+  // so a new output is one that changed or one due by the output period
+  sample.magnt_new = memcmp(compass_data, _compass_raw, sizeof(compass_data)) != 0
+    || sample.timestamp - _compass_timestamp >= _compass_period;
+  if(sample.magnt_new) {
+    memcpy(_compass_raw, compass_data, sizeof(compass_data));
+    _compass_timestamp = sample.timestamp;
+  }
+
+  return true;
+}
+
+/**
+ * @bref  Read the accelerometer alone
+ * @param None
+ * @return Acceleration in g
+ */
+Accel GY_85::get_acceleration_data(void) {
+  accelero.get_raw_data();
+  return {accelero.get_x_value(), accelero.get_y_value(), accelero.get_z_value()};
+}
+
+/**
+ * @bref  Read the gyroscope alone
+ * @param None
+ * @return Angular rate in °/s
+ */
+Gyros GY_85::get_gyroscope_data(void) {
+  gyroscope.get_raw_data();
+  return {gyroscope.get_x_value(), gyroscope.get_y_value(), gyroscope.get_z_value()};
+}
+
+/**
+ * @bref  Read the magnetometer alone
+ * @param None
+ * @return Magnetic field in mG
+ */
+Magnt GY_85::get_magnetometer_data(void) {
+  compass.get_raw_data();
+  return {compass.get_x_value(), compass.get_y_value(), compass.get_z_value()};
+}
@@ -0,0 +1,115 @@
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#include "GY_85_Sampler.hpp"
+
+GY_85_Sampler::GY_85_Sampler(GY_85 &imu, uint16_t sample_rate) : _imu(imu),
+  _running(false), _overruns(0), _missed_periods(0), _read_errors(0) {
+  _period_ns = 1000000000ull/(sample_rate > 0 ? sample_rate : 1);
+  _imu.set_sample_rate(sample_rate);
+}
+
+GY_85_Sampler::~GY_85_Sampler() {
+  stop();
+}
+
+/**
+ * @bref  Start sampling in a new thread
+ * @param SCHED_FIFO priority, 0 for the default scheduling
+ * @param Core to pin the thread to, -1 for any
+ * @return true if the scheduling could be applied or false if don't
+ */
+bool GY_85_Sampler::start(int priority, int cpu) {
+  if(_running.exchange(true)) {
+    return true;
+  }
+  _thread = std::thread(&GY_85_Sampler::run, this);
+
+  bool b = true;
+  if(priority > 0) {
+    sched_param param;
+    param.sched_priority = priority;
+    b = pthread_setschedparam(_thread.native_handle(), SCHED_FIFO, &param) == 0;
+  }
+  if(cpu >= 0) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    b = pthread_setaffinity_np(_thread.native_handle(), sizeof(cpus), &cpus) == 0 && b;
+  }
+
+  return b;
+}
+
+/**
+ * @bref  Stop the sampling thread and wait for it
+ * @param None
+ * @return None
+ */
+void GY_85_Sampler::stop(void) {
+  _running = false;
+  if(_thread.joinable()) {
+    _thread.join();
+  }
+}
+
+/**
+ * @bref  Take the oldest samples out of the buffer
+ * @param Array to fill
+ * @param Size of the array
+ * @return How many samples were copied
+ */
+size_t GY_85_Sampler::drain(GY_85_Sample *samples, size_t max_samples) {
+  return _samples.pop(samples, max_samples);
+}
+
+uint64_t GY_85_Sampler::get_overruns(void) {
+  return _overruns.load(std::memory_order_relaxed);
+}
+
+uint64_t GY_85_Sampler::get_missed_periods(void) {
+  return _missed_periods.load(std::memory_order_relaxed);
+}
+
+uint64_t GY_85_Sampler::get_read_errors(void) {
+  return _read_errors.load(std::memory_order_relaxed);
+}
+
+/**
+ * @bref  Sampling loop, wakes up on absolute deadlines so the period doesn't
+ *        drift with the time spent reading
+ * @param None
+ * @return None
+ */
+void GY_85_Sampler::run(void) {
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  uint64_t deadline = (uint64_t)now.tv_sec*1000000000 + now.tv_nsec;
+
+  GY_85_Sample sample;
+  while(_running.load(std::memory_order_relaxed)) {
+    if(!_imu.read(sample)) {
+      _read_errors.fetch_add(1, std::memory_order_relaxed);
+    } else if(!_samples.push(sample)) {
+      _overruns.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    deadline += _period_ns;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t now_ns = (uint64_t)now.tv_sec*1000000000 + now.tv_nsec;
+    if(now_ns > deadline) {
+      // Too late for one or more periods, skip them rather than bursting
+      uint64_t missed = (now_ns - deadline)/_period_ns + 1;
+      _missed_periods.fetch_add(missed, std::memory_order_relaxed);
+      deadline += missed*_period_ns;
+    }
+
+    timespec wakeup;
+    wakeup.tv_sec = deadline/1000000000;
+    wakeup.tv_nsec = deadline%1000000000;
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wakeup, nullptr) != 0) {
+      // interrupted by a signal, sleep again until the deadline
+    }
+  }
+}
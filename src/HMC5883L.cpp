@@ -142,14 +142,25 @@ float HMC5883L::get_z_value(void) {
  * @return None
  */
 void HMC5883L::get_raw_data(void) {
-  uint16_t data[3];
-  if(readRegister(HMC5883_DATA_OUTPUT_X_MSB, (uint8_t *)data, 6)) {
-    _x_axis = ((int16_t)htobe16(data[0]))*_digital_resolution;
-    _y_axis = ((int16_t)htobe16(data[1]))*_digital_resolution;
-    _z_axis = ((int16_t)htobe16(data[2]))*_digital_resolution;
+  uint8_t data[6];
+  if(readRegister(HMC5883_DATA_OUTPUT_X_MSB, data, 6)) {
+    parse_raw_data(data);
   }
 }
 
+/**
+ * @bref  Convert a burst of the data output registers
+ * @param 6 bytes read from HMC5883_DATA_OUTPUT_X_MSB, ordered X, Z, Y
+ * @return None
+ */
+void HMC5883L::parse_raw_data(const uint8_t *raw) {
+  uint16_t data[3];
+  memcpy(data, raw, sizeof(data));
+  _x_axis = ((int16_t)htobe16(data[0]))*_digital_resolution;
+  _z_axis = ((int16_t)htobe16(data[1]))*_digital_resolution;
+  _y_axis = ((int16_t)htobe16(data[2]))*_digital_resolution;
+}
+
 /**
  * @bref  Return the status if there's new values to read
  * @param None
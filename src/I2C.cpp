@@ -9,6 +9,7 @@
 #include <unistd.h>
 #include <sys/stat.h>
 #include <sys/ioctl.h>
+#include <linux/i2c.h>
 #include <linux/i2c-dev.h>
 
 // Identify the error
@@ -29,6 +30,7 @@ I2C::I2C(char const *i2c_path) {
 
 bool I2C::read_register(uint8_t deviceAddress, uint8_t registerAddress,
                         uint8_t *dataPointer, uint8_t length) {
+  std::lock_guard<std::mutex> guard(_bus_mutex);
 
   if (ioctl(_i2c_file, I2C_SLAVE, deviceAddress) < 0) {
     perror("Problem with device communication: ");
@@ -45,6 +47,7 @@ bool I2C::read_register(uint8_t deviceAddress, uint8_t registerAddress,
 
 bool I2C::write_register(uint8_t deviceAddress, uint8_t registerAddress,
                          uint8_t *dataPointer, uint8_t length) {
+  std::lock_guard<std::mutex> guard(_bus_mutex);
 
   if (ioctl(_i2c_file, I2C_SLAVE, deviceAddress) < 0) {
     perror("Problem with device communication: ");
@@ -63,3 +66,34 @@ bool I2C::write_register(uint8_t deviceAddress, uint8_t registerAddress,
 
   return true;
 }
+
+bool I2C::transfer(I2CMessage *messages, uint32_t count) {
+  std::lock_guard<std::mutex> guard(_bus_mutex);
+
+  i2c_msg msgs[I2C_RDWR_IOCTL_MAX_MSGS];
+  i2c_rdwr_ioctl_data transaction;
+  transaction.msgs = msgs;
+
+  // The kernel limits how many messages go in one transaction
+  for(uint32_t first = 0; first < count; first += I2C_RDWR_IOCTL_MAX_MSGS) {
+    uint32_t n = count - first;
+    if(n > I2C_RDWR_IOCTL_MAX_MSGS) {
+      n = I2C_RDWR_IOCTL_MAX_MSGS;
+    }
+
+    for(uint32_t i = 0; i < n; ++i) {
+      msgs[i].addr = messages[first + i].device_address;
+      msgs[i].flags = messages[first + i].read ? I2C_M_RD : 0;
+      msgs[i].len = messages[first + i].length;
+      msgs[i].buf = messages[first + i].data;
+    }
+    transaction.nmsgs = n;
+
+    if(ioctl(_i2c_file, I2C_RDWR, &transaction) < 0) {
+      perror("I2C Transfer failed: ");
+      return false;
+    }
+  }
+
+  return true;
+}
@@ -98,7 +98,7 @@ uint8_t ITG_3205::get_interrupt_configuration(void) {
  * @return true if success or false if don't
  */
 bool ITG_3205::set_interrupt_configuration(uint8_t config) {
-  bool b = this->writeRegister(ITG_3205_DLPF_FS, config);
+  bool b = this->writeRegister(ITG_3205_INT_CFG, config);
   if(b) {
     this->_interrupt_config = config;
   }
@@ -160,15 +160,26 @@ float ITG_3205::get_z_value(void) {
  * @return None
  */
 void ITG_3205::get_raw_data(void) {
-  uint16_t data[4];
-  if(readRegister(ITG_3205_TEMP_OUT_H, (uint8_t *)data, 8)) {
-    _temperature = 35 + (((int16_t)htobe16(data[0])) + 13200)/280;
-    _x_axis = ((int16_t)htobe16(data[1]))/14.375;
-    _y_axis = ((int16_t)htobe16(data[2]))/14.375;
-    _z_axis = ((int16_t)htobe16(data[3]))/14.375;
+  uint8_t data[8];
+  if(readRegister(ITG_3205_TEMP_OUT_H, data, 8)) {
+    parse_raw_data(data);
   }
 }
 
+/**
+ * @bref  Convert a burst of the temperature and gyro registers
+ * @param 8 bytes read from ITG_3205_TEMP_OUT_H to ITG_3205_GYRO_ZOUT_L
+ * @return None
+ */
+void ITG_3205::parse_raw_data(const uint8_t *raw) {
+  uint16_t data[4];
+  memcpy(data, raw, sizeof(data));
+  _temperature = 35 + (((int16_t)htobe16(data[0])) + 13200)/280.0;
+  _x_axis = ((int16_t)htobe16(data[1]))/14.375;
+  _y_axis = ((int16_t)htobe16(data[2]))/14.375;
+  _z_axis = ((int16_t)htobe16(data[3]))/14.375;
+}
+
 /**
  * @bref  Return the operation mode of the device (see .hpp)
  * @param None
@@ -0,0 +1,314 @@
+#include <algorithm>
+#include <cmath>
+
+#include "KDTree.hpp"
+
+#define LEAF 3
+
+// Queries run at a time by a thread
+#define QUERY_GRAIN 64
+
+// Deeper than any tree over 2^32 points
+#define STACK_SIZE 64
+
+static inline float coordinate(const Vector3 &p, uint32_t axis) {
+  return axis == 0 ? p.x : (axis == 1 ? p.y : p.z);
+}
+
+KDTree::KDTree(ThreadPool &pool) : _pool(pool) {
+}
+
+void KDTree::build(const ScanPoint *points, size_t count) {
+  std::vector<Vector3> positions(count);
+  for(size_t i = 0; i < count; ++i) {
+    positions[i] = points[i].position;
+  }
+  build(positions.data(), count);
+}
+
+/**
+ * @bref  Build the tree one level at a time, splitting the nodes of a level
+ *        in parallel
+ * @param Positions
+ * @param How many
+ * @return None
+ */
+void KDTree::build(const Vector3 *positions, size_t count) {
+  _entries.resize(count);
+  for(size_t i = 0; i < count; ++i) {
+    _entries[i] = {positions[i], (uint32_t)i};
+  }
+  _nodes.assign(1, {0, LEAF, 0, (uint32_t)count});
+
+  std::vector<uint32_t> level(1, 0), next;
+  while(!level.empty()) {
+    _pool.parallel_for(level.size(), [this, &level](size_t begin, size_t end, size_t) {
+      for(size_t i = begin; i < end; ++i) {
+        split(level[i]);
+      }
+    });
+
+    next.clear();
+    for(uint32_t node : level) {
+      if(_nodes[node].axis == LEAF) {
+        continue;
+      }
+      uint32_t left = 2*node + 1;
+      if(_nodes.size() < left + 2) {
+        _nodes.resize(left + 2, {0, LEAF, 0, 0});
+      }
+      uint32_t begin = _nodes[node].begin, end = _nodes[node].end;
+      uint32_t mid = begin + (end - begin)/2;
+      _nodes[left] = {0, LEAF, begin, mid};
+      _nodes[left + 1] = {0, LEAF, mid, end};
+      next.push_back(left);
+      next.push_back(left + 1);
+    }
+    level.swap(next);
+  }
+}
+
+/**
+ * @bref  Find the nearest points, keeping the best ones sorted
+ * @param Query point
+ * @param How many neighbours
+ * @param Indexes out
+ * @param Squared distances out
+ * @return How many were found
+ */
+size_t KDTree::knn(const Vector3 &query, size_t k, uint32_t *indices, float *distances) {
+  if(k > KDTREE_MAX_K) {
+    k = KDTREE_MAX_K;
+  }
+  if(k == 0 || _entries.empty()) {
+    return 0;
+  }
+
+  size_t found = 0;
+  uint32_t stack[STACK_SIZE];
+  float bounds[STACK_SIZE];
+  size_t top = 0;
+  stack[top] = 0;
+  bounds[top++] = 0;
+
+  while(top > 0) {
+    --top;
+    uint32_t n = stack[top];
+    float bound = bounds[top];
+    if(found == k && bound >= distances[k - 1]) {
+      continue;
+    }
+
+    const Node &node = _nodes[n];
+    if(node.axis == LEAF) {
+      for(uint32_t i = node.begin; i < node.end; ++i) {
+        Vector3 d = _entries[i].position - query;
+        float d2 = d.dot(d);
+        if(found == k && d2 >= distances[k - 1]) {
+          continue;
+        }
+        // Insertion into the sorted list, k is small
+        size_t j = found < k ? found++ : k - 1;
+        while(j > 0 && distances[j - 1] > d2) {
+          distances[j] = distances[j - 1];
+          indices[j] = indices[j - 1];
+          --j;
+        }
+        distances[j] = d2;
+        indices[j] = _entries[i].index;
+      }
+      continue;
+    }
+
+    // The far side goes below the near one on the stack
+    float diff = coordinate(query, node.axis) - node.split;
+    uint32_t near = diff < 0 ? 2*n + 1 : 2*n + 2;
+    uint32_t far = diff < 0 ? 2*n + 2 : 2*n + 1;
+    stack[top] = far;
+    bounds[top++] = std::max(bound, diff*diff);
+    stack[top] = near;
+    bounds[top++] = bound;
+  }
+
+  return found;
+}
+
+void KDTree::knn(const Vector3 *queries, size_t count, size_t k, uint32_t *indices, float *distances) {
+  if(k > KDTREE_MAX_K) {
+    k = KDTREE_MAX_K;
+  }
+  _pool.parallel_for(count, [this, queries, k, indices, distances](size_t begin, size_t end, size_t) {
+    for(size_t q = begin; q < end; ++q) {
+      size_t found = knn(queries[q], k, indices + q*k, distances + q*k);
+      for(size_t i = found; i < k; ++i) {
+        indices[q*k + i] = KDTREE_NONE;
+        distances[q*k + i] = INFINITY;
+      }
+    }
+  }, QUERY_GRAIN);
+}
+
+/**
+ * @bref  Find the points within a radius
+ * @param Query point
+ * @param Radius
+ * @param Indexes out, appended to
+ * @return How many were found
+ */
+size_t KDTree::radius(const Vector3 &query, float radius, std::vector<uint32_t> &indices) {
+  if(_entries.empty()) {
+    return 0;
+  }
+
+  float r2 = radius*radius;
+  size_t found = 0;
+  uint32_t stack[STACK_SIZE];
+  size_t top = 0;
+  stack[top++] = 0;
+
+  while(top > 0) {
+    uint32_t n = stack[--top];
+    const Node &node = _nodes[n];
+    if(node.axis == LEAF) {
+      for(uint32_t i = node.begin; i < node.end; ++i) {
+        Vector3 d = _entries[i].position - query;
+        if(d.dot(d) <= r2) {
+          indices.push_back(_entries[i].index);
+          ++found;
+        }
+      }
+      continue;
+    }
+
+    float diff = coordinate(query, node.axis) - node.split;
+    if(diff <= radius) {
+      stack[top++] = 2*n + 1;
+    }
+    if(diff >= -radius) {
+      stack[top++] = 2*n + 2;
+    }
+  }
+
+  return found;
+}
+
+/**
+ * @bref  Radius search of many queries in parallel, each range of queries
+ *        collects its results on its own before they are concatenated
+ * @param Query points
+ * @param How many
+ * @param Radius
+ * @param Offsets out, count + 1 of them
+ * @param Indexes out
+ * @return None
+ */
+void KDTree::radius(const Vector3 *queries, size_t count, float radius, std::vector<uint32_t> &offsets,
+  std::vector<uint32_t> &indices) {
+  size_t ranges = (count + QUERY_GRAIN - 1)/QUERY_GRAIN;
+  std::vector<std::vector<uint32_t>> results(ranges);
+  offsets.assign(count + 1, 0);
+
+  _pool.parallel_for(count, [this, queries, radius, &results, &offsets](size_t begin, size_t end, size_t) {
+    std::vector<uint32_t> &result = results[begin/QUERY_GRAIN];
+    for(size_t q = begin; q < end; ++q) {
+      offsets[q + 1] = this->radius(queries[q], radius, result);
+    }
+  }, QUERY_GRAIN);
+
+  for(size_t q = 0; q < count; ++q) {
+    offsets[q + 1] += offsets[q];
+  }
+  indices.resize(offsets[count]);
+  for(size_t r = 0; r < ranges; ++r) {
+    std::copy(results[r].begin(), results[r].end(), indices.begin() + offsets[r*QUERY_GRAIN]);
+  }
+}
+
+/**
+ * @bref  Count the points within a radius, up to a limit
+ * @param Query point
+ * @param Radius
+ * @param Count at which to stop
+ * @return How many were found, at most limit
+ */
+size_t KDTree::count(const Vector3 &query, float radius, size_t limit) {
+  if(_entries.empty()) {
+    return 0;
+  }
+
+  float r2 = radius*radius;
+  size_t found = 0;
+  uint32_t stack[STACK_SIZE];
+  size_t top = 0;
+  stack[top++] = 0;
+
+  while(top > 0 && found < limit) {
+    uint32_t n = stack[--top];
+    const Node &node = _nodes[n];
+    if(node.axis == LEAF) {
+      for(uint32_t i = node.begin; i < node.end && found < limit; ++i) {
+        Vector3 d = _entries[i].position - query;
+        found += d.dot(d) <= r2 ? 1 : 0;
+      }
+      continue;
+    }
+
+    float diff = coordinate(query, node.axis) - node.split;
+    // Near side last so it's searched first, the limit may be reached there
+    bool left = diff <= radius, right = diff >= -radius;
+    if(diff < 0) {
+      if(right) {
+        stack[top++] = 2*n + 2;
+      }
+      if(left) {
+        stack[top++] = 2*n + 1;
+      }
+    } else {
+      if(left) {
+        stack[top++] = 2*n + 1;
+      }
+      if(right) {
+        stack[top++] = 2*n + 2;
+      }
+    }
+  }
+
+  return found;
+}
+
+size_t KDTree::size(void) {
+  return _entries.size();
+}
+
+uint32_t KDTree::get_index(size_t i) {
+  return _entries[i].index;
+}
+
+/**
+ * @bref  Split a node at the median of its widest side, or leave it a leaf
+ * @param Node
+ * @return None
+ */
+void KDTree::split(uint32_t n) {
+  Node &node = _nodes[n];
+  if(node.end - node.begin <= KDTREE_BUCKET) {
+    return;
+  }
+
+  Vector3 min = _entries[node.begin].position, max = min;
+  for(uint32_t i = node.begin + 1; i < node.end; ++i) {
+    const Vector3 &p = _entries[i].position;
+    min = {std::min(min.x, p.x), std::min(min.y, p.y), std::min(min.z, p.z)};
+    max = {std::max(max.x, p.x), std::max(max.y, p.y), std::max(max.z, p.z)};
+  }
+  Vector3 extent = max - min;
+  uint32_t axis = extent.x >= extent.y ? (extent.x >= extent.z ? 0 : 2) : (extent.y >= extent.z ? 1 : 2);
+
+  uint32_t mid = node.begin + (node.end - node.begin)/2;
+  std::nth_element(_entries.begin() + node.begin, _entries.begin() + mid, _entries.begin() + node.end,
+    [axis](const Entry &a, const Entry &b) {
+      return coordinate(a.position, axis) < coordinate(b.position, axis);
+    });
+  node.split = coordinate(_entries[mid].position, axis);
+  node.axis = axis;
+}
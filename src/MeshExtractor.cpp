@@ -0,0 +1,426 @@
+#include <cstdio>
+#include <endian.h>
+#include <string.h>
+#include <unordered_map>
+
+#include "MeshExtractor.hpp"
+
+#define B TSDF_BLOCK_SIZE
+// Voxels along an edge of a block with the layer taken from its neighbours
+#define G (TSDF_BLOCK_SIZE + 1)
+
+// Bits per voxel coordinate in an edge key, the last 2 bits hold the axis
+#define KEY_BITS 20
+#define KEY_OFFSET (1 << (KEY_BITS - 1))
+#define KEY_MASK ((1ULL << KEY_BITS) - 1)
+
+// Most triangles a cube case has: a loop through all 12 edges
+#define MAX_CUBE_TRIANGLES 10
+
+// Corner i of a cube is at x = i & 1, y = i >> 1 & 1, z = i >> 2 & 1
+static const uint8_t cube_edges[12][2] = {
+  {0, 1}, {2, 3}, {4, 5}, {6, 7},
+  {0, 2}, {1, 3}, {4, 6}, {5, 7},
+  {0, 4}, {1, 5}, {2, 6}, {3, 7}};
+
+static const uint8_t cube_faces[6][4] = {
+  {0, 2, 6, 4}, {1, 3, 7, 5},
+  {0, 1, 5, 4}, {2, 3, 7, 6},
+  {0, 1, 3, 2}, {4, 5, 7, 6}};
+
+struct CubeCase {
+  uint8_t count;
+  uint8_t edges[3*MAX_CUBE_TRIANGLES];
+};
+
+static CubeCase cube_cases[256];
+
+static inline Vector3 corner_position(int corner) {
+  return {(float)(corner & 1), (float)(corner >> 1 & 1), (float)(corner >> 2 & 1)};
+}
+
+static inline int edge_between(int a, int b) {
+  for(int e = 0; e < 12; ++e) {
+    if((cube_edges[e][0] == a && cube_edges[e][1] == b) || (cube_edges[e][0] == b && cube_edges[e][1] == a)) {
+      return e;
+    }
+  }
+  return -1;
+}
+
+/**
+ * @bref  Build the triangles of every cube case: each face pairs the edges
+ *        the surface crosses, the pairs chain into loops around the cube
+ *        and each loop is fanned into triangles facing the outside corners
+ * @param None
+ * @return None
+ */
+static bool build_cube_cases(void) {
+  for(int config = 0; config < 256; ++config) {
+    CubeCase &cube = cube_cases[config];
+    cube.count = 0;
+    int links[12][2];
+    memset(links, -1, sizeof(links));
+
+    for(const uint8_t *face : cube_faces) {
+      int crossed[4];
+      for(int k = 0; k < 4; ++k) {
+        int a = face[k], b = face[(k + 1) % 4];
+        crossed[k] = (config >> a & 1) != (config >> b & 1) ? edge_between(a, b) : -1;
+      }
+
+      int pairs[2][2], count = 0;
+      int n = (crossed[0] >= 0) + (crossed[1] >= 0) + (crossed[2] >= 0) + (crossed[3] >= 0);
+      if(n == 2) {
+        int *pair = pairs[count++];
+        int m = 0;
+        for(int k = 0; k < 4; ++k) {
+          if(crossed[k] >= 0) {
+            pair[m++] = crossed[k];
+          }
+        }
+      } else if(n == 4) {
+        // Ambiguous face, cut off each inside corner on its own
+        if(config >> face[0] & 1) {
+          pairs[0][0] = crossed[3]; pairs[0][1] = crossed[0];
+          pairs[1][0] = crossed[1]; pairs[1][1] = crossed[2];
+        } else {
+          pairs[0][0] = crossed[0]; pairs[0][1] = crossed[1];
+          pairs[1][0] = crossed[2]; pairs[1][1] = crossed[3];
+        }
+        count = 2;
+      }
+
+      for(int p = 0; p < count; ++p) {
+        int a = pairs[p][0], b = pairs[p][1];
+        links[a][links[a][0] < 0 ? 0 : 1] = b;
+        links[b][links[b][0] < 0 ? 0 : 1] = a;
+      }
+    }
+
+    bool visited[12] = {false};
+    for(int start = 0; start < 12; ++start) {
+      if(links[start][0] < 0 || visited[start]) {
+        continue;
+      }
+      int loop[12], length = 0;
+      int previous = -1, edge = start;
+      do {
+        visited[edge] = true;
+        loop[length++] = edge;
+        int next = links[edge][0] != previous ? links[edge][0] : links[edge][1];
+        previous = edge;
+        edge = next;
+      } while(edge != start);
+
+      // Turn the loop so its normal points from the inside corners to the outside ones
+      Vector3 normal = {0, 0, 0}, outward = {0, 0, 0};
+      for(int i = 0; i < length; ++i) {
+        const uint8_t *e = cube_edges[loop[i]], *f = cube_edges[loop[(i + 1) % length]];
+        Vector3 p = (corner_position(e[0]) + corner_position(e[1]))*0.5f;
+        Vector3 q = (corner_position(f[0]) + corner_position(f[1]))*0.5f;
+        normal += p.cross(q);
+        bool first_inside = config >> e[0] & 1;
+        outward += (corner_position(e[1]) - corner_position(e[0]))*(first_inside ? 1.0f : -1.0f);
+      }
+      if(normal.dot(outward) < 0) {
+        for(int i = 0; i < length/2; ++i) {
+          int t = loop[i];
+          loop[i] = loop[length - 1 - i];
+          loop[length - 1 - i] = t;
+        }
+      }
+
+      for(int i = 1; i + 1 < length; ++i) {
+        uint8_t *triangle = cube.edges + 3*cube.count++;
+        triangle[0] = loop[0];
+        triangle[1] = loop[i];
+        triangle[2] = loop[i + 1];
+      }
+    }
+  }
+  return true;
+}
+
+static const bool cube_cases_built = build_cube_cases();
+
+static inline uint64_t edge_key(int32_t x, int32_t y, int32_t z, int axis) {
+  return (((uint64_t)(x + KEY_OFFSET) & KEY_MASK) << (2*KEY_BITS + 2)) |
+    (((uint64_t)(y + KEY_OFFSET) & KEY_MASK) << (KEY_BITS + 2)) |
+    (((uint64_t)(z + KEY_OFFSET) & KEY_MASK) << 2) | axis;
+}
+
+static inline void put_uint32(FILE *file, uint32_t value) {
+  value = htole32(value);
+  fwrite(&value, sizeof(value), 1, file);
+}
+
+static inline void put_float(FILE *file, float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  put_uint32(file, bits);
+}
+
+MeshExtractor::MeshExtractor(TSDFVolume &volume, ThreadPool &pool) : _volume(volume), _pool(pool) {
+  (void)cube_cases_built;
+  _min_weight = 1.0f;
+  _edge_vertices.resize(pool.size(), std::vector<int32_t>(G*G*G*3));
+}
+
+bool MeshExtractor::set_min_weight(float weight) {
+  if(!(weight > 0)) {
+    return false;
+  }
+  _min_weight = weight;
+  // Every cube may change
+  for(BlockMesh &mesh : _meshes) {
+    mesh.pass = 0;
+  }
+  return true;
+}
+
+/**
+ * @bref  Mesh the blocks that changed since their last meshing, in parallel
+ * @param None
+ * @return How many blocks were meshed
+ */
+size_t MeshExtractor::update(void) {
+  size_t blocks = _volume.get_block_count();
+  if(blocks < _meshes.size()) {
+    // The volume was cleared
+    _meshes.clear();
+  }
+  _meshes.resize(blocks);
+
+  std::vector<uint32_t> dirty;
+  for(size_t b = 0; b < blocks; ++b) {
+    if(changed(b)) {
+      dirty.push_back(b);
+    }
+  }
+
+  _pool.parallel_for(dirty.size(), [this, &dirty](size_t begin, size_t end, size_t thread) {
+    for(size_t i = begin; i < end; ++i) {
+      mesh_block(dirty[i], _edge_vertices[thread]);
+    }
+  });
+
+  uint32_t pass = _volume.get_pass();
+  for(uint32_t b : dirty) {
+    _meshes[b].pass = pass;
+  }
+  return dirty.size();
+}
+
+/**
+ * @bref  Update the block meshes and merge them, joining the vertices they
+ *        share on their borders
+ * @param Mesh out
+ * @return None
+ */
+void MeshExtractor::extract(Mesh &mesh) {
+  update();
+
+  size_t vertices = 0, triangles = 0;
+  for(const BlockMesh &block : _meshes) {
+    vertices += block.vertices.size();
+    triangles += block.triangles.size();
+  }
+  mesh.vertices.clear();
+  mesh.vertices.reserve(vertices);
+  mesh.triangles.resize(triangles);
+
+  std::unordered_map<uint64_t, uint32_t> indexes;
+  indexes.reserve(vertices);
+  std::vector<uint32_t> remap;
+  size_t t = 0;
+  for(const BlockMesh &block : _meshes) {
+    remap.resize(block.vertices.size());
+    for(size_t v = 0; v < block.vertices.size(); ++v) {
+      auto inserted = indexes.emplace(block.keys[v], (uint32_t)mesh.vertices.size());
+      if(inserted.second) {
+        mesh.vertices.push_back(block.vertices[v]);
+      }
+      remap[v] = inserted.first->second;
+    }
+    for(uint32_t index : block.triangles) {
+      mesh.triangles[t++] = remap[index];
+    }
+  }
+}
+
+/**
+ * @bref  Write a mesh to a binary little endian PLY file
+ * @param File path
+ * @param Mesh
+ * @return true if success or false if don't
+ */
+bool MeshExtractor::write_ply(const std::string &path, const Mesh &mesh) {
+  FILE *file = fopen(path.c_str(), "wb");
+  if(file == nullptr) {
+    perror("Failed to open mesh file");
+    return false;
+  }
+  setvbuf(file, nullptr, _IOFBF, 1 << 20);
+
+  fprintf(file, "ply\nformat binary_little_endian 1.0\n"
+    "element vertex %zu\nproperty float x\nproperty float y\nproperty float z\n"
+    "element face %zu\nproperty list uchar uint vertex_indices\nend_header\n",
+    mesh.vertices.size(), mesh.triangles.size()/3);
+  for(const Vector3 &v : mesh.vertices) {
+    put_float(file, v.x);
+    put_float(file, v.y);
+    put_float(file, v.z);
+  }
+  for(size_t i = 0; i + 2 < mesh.triangles.size(); i += 3) {
+    fputc(3, file);
+    put_uint32(file, mesh.triangles[i]);
+    put_uint32(file, mesh.triangles[i + 1]);
+    put_uint32(file, mesh.triangles[i + 2]);
+  }
+
+  bool b = !ferror(file);
+  b = fclose(file) == 0 && b;
+  if(!b) {
+    perror("Failed to write mesh file");
+  }
+  return b;
+}
+
+/**
+ * @bref  Write a mesh to a binary STL file, which repeats the vertices of
+ *        every triangle
+ * @param File path
+ * @param Mesh
+ * @return true if success or false if don't
+ */
+bool MeshExtractor::write_stl(const std::string &path, const Mesh &mesh) {
+  FILE *file = fopen(path.c_str(), "wb");
+  if(file == nullptr) {
+    perror("Failed to open mesh file");
+    return false;
+  }
+  setvbuf(file, nullptr, _IOFBF, 1 << 20);
+
+  char header[80] = {0};
+  strncpy(header, "handheld 3d scanner mesh", sizeof(header) - 1);
+  fwrite(header, sizeof(header), 1, file);
+  put_uint32(file, mesh.triangles.size()/3);
+  for(size_t i = 0; i + 2 < mesh.triangles.size(); i += 3) {
+    const Vector3 &a = mesh.vertices[mesh.triangles[i]];
+    const Vector3 &b = mesh.vertices[mesh.triangles[i + 1]];
+    const Vector3 &c = mesh.vertices[mesh.triangles[i + 2]];
+    Vector3 n = (b - a).cross(c - a);
+    float length = n.norm();
+    n = length > 0 ? n*(1.0f/length) : n;
+    for(const Vector3 &v : {n, a, b, c}) {
+      put_float(file, v.x);
+      put_float(file, v.y);
+      put_float(file, v.z);
+    }
+    uint16_t attributes = 0;
+    fwrite(&attributes, sizeof(attributes), 1, file);
+  }
+
+  bool b = !ferror(file);
+  b = fclose(file) == 0 && b;
+  if(!b) {
+    perror("Failed to write mesh file");
+  }
+  return b;
+}
+
+/**
+ * @bref  Whether a block or a neighbour its cubes reach into changed since
+ *        the block was meshed
+ * @param Block index
+ * @return true if it needs meshing again
+ */
+bool MeshExtractor::changed(size_t block) {
+  const TSDFBlock &b = _volume.get_block(block);
+  uint32_t pass = _meshes[block].pass;
+  if(pass == 0 || b.updated > pass) {
+    return true;
+  }
+  for(int n = 1; n < 8; ++n) {
+    const TSDFBlock *neighbour = _volume.find_block(b.x + (n & 1), b.y + (n >> 1 & 1), b.z + (n >> 2 & 1));
+    if(neighbour != nullptr && neighbour->updated > pass) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @bref  Run marching cubes over the cubes starting in a block
+ * @param Block index
+ * @param Scratch space mapping the edges to vertices
+ * @return None
+ */
+void MeshExtractor::mesh_block(size_t block, std::vector<int32_t> &edge_vertices) {
+  const TSDFBlock &b = _volume.get_block(block);
+  BlockMesh &mesh = _meshes[block];
+  mesh.vertices.clear();
+  mesh.keys.clear();
+  mesh.triangles.clear();
+
+  const TSDFBlock *blocks[8];
+  blocks[0] = &b;
+  for(int n = 1; n < 8; ++n) {
+    blocks[n] = _volume.find_block(b.x + (n & 1), b.y + (n >> 1 & 1), b.z + (n >> 2 & 1));
+  }
+
+  // The voxels of the block and the layer past its far sides, the missing
+  // ones with no weight
+  static thread_local TSDFVoxel grid[G][G][G];
+  for(int z = 0; z < G; ++z) {
+    for(int y = 0; y < G; ++y) {
+      for(int x = 0; x < G; ++x) {
+        const TSDFBlock *source = blocks[(x / B) | (y / B) << 1 | (z / B) << 2];
+        grid[z][y][x] = source != nullptr ? source->voxels[(x % B) + B*((y % B) + B*(z % B))] : TSDFVoxel{0, 0};
+      }
+    }
+  }
+
+  std::fill(edge_vertices.begin(), edge_vertices.end(), -1);
+  float size = _volume.get_voxel_size();
+  int32_t ox = b.x*B, oy = b.y*B, oz = b.z*B;
+
+  for(int z = 0; z < B; ++z) {
+    for(int y = 0; y < B; ++y) {
+      for(int x = 0; x < B; ++x) {
+        const TSDFVoxel *corners[8];
+        int config = 0;
+        bool observed = true;
+        for(int c = 0; c < 8; ++c) {
+          corners[c] = &grid[z + (c >> 2 & 1)][y + (c >> 1 & 1)][x + (c & 1)];
+          observed = observed && corners[c]->weight >= _min_weight;
+          config |= (corners[c]->sdf < 0 ? 1 : 0) << c;
+        }
+        if(!observed || config == 0 || config == 255) {
+          continue;
+        }
+
+        const CubeCase &cube = cube_cases[config];
+        for(int i = 0; i < 3*cube.count; ++i) {
+          int e = cube.edges[i];
+          int c0 = cube_edges[e][0], c1 = cube_edges[e][1];
+          int axis = e/4;
+          int lx = x + (c0 & 1), ly = y + (c0 >> 1 & 1), lz = z + (c0 >> 2 & 1);
+          int32_t &vertex = edge_vertices[((lz*G + ly)*G + lx)*3 + axis];
+          if(vertex < 0) {
+            float s0 = corners[c0]->sdf, s1 = corners[c1]->sdf;
+            float t = s0/(s0 - s1);
+            Vector3 p = {(ox + lx + 0.5f)*size, (oy + ly + 0.5f)*size, (oz + lz + 0.5f)*size};
+            float *coordinate = axis == 0 ? &p.x : (axis == 1 ? &p.y : &p.z);
+            *coordinate += t*size;
+            vertex = mesh.vertices.size();
+            mesh.vertices.push_back(p);
+            mesh.keys.push_back(edge_key(ox + lx, oy + ly, oz + lz, axis));
+          }
+          mesh.triangles.push_back(vertex);
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,154 @@
+#include <cmath>
+
+#include "NormalEstimator.hpp"
+
+// Points estimated at a time by a thread
+#define ESTIMATE_GRAIN 256
+
+// Below this share of the largest variance, the middle one doesn't make
+// the neighbours a surface but a line
+#define LINE_SPREAD 1e-2
+
+/**
+ * @bref  Eigenvalues of a symmetric 3x3 matrix, with their closed form
+ *        (Smith, 1961)
+ * @param Upper triangle a00, a01, a02, a11, a12, a22
+ * @param Eigenvalues out, ascending
+ * @return None
+ */
+static void eigenvalues(const double a[6], double values[3]) {
+  double p1 = a[1]*a[1] + a[2]*a[2] + a[4]*a[4];
+  double q = (a[0] + a[3] + a[5])/3;
+  double d0 = a[0] - q, d1 = a[3] - q, d2 = a[5] - q;
+  double p = sqrt((d0*d0 + d1*d1 + d2*d2 + 2*p1)/6);
+  if(p < 1e-30) {
+    values[0] = values[1] = values[2] = q;
+    return;
+  }
+
+  // det((A - qI)/p)/2 is the cosine of three times the angle
+  double b0 = d0/p, b1 = a[1]/p, b2 = a[2]/p, b3 = d1/p, b4 = a[4]/p, b5 = d2/p;
+  double r = (b0*(b3*b5 - b4*b4) - b1*(b1*b5 - b4*b2) + b2*(b1*b4 - b3*b2))/2;
+  r = r < -1 ? -1 : (r > 1 ? 1 : r);
+  double phi = acos(r)/3;
+  values[2] = q + 2*p*cos(phi);
+  values[0] = q + 2*p*cos(phi + 2*M_PI/3);
+  values[1] = 3*q - values[0] - values[2];
+}
+
+/**
+ * @bref  Eigenvector of a symmetric 3x3 matrix for a simple eigenvalue
+ * @param Upper triangle a00, a01, a02, a11, a12, a22
+ * @param Eigenvalue
+ * @param Eigenvector out, unit length
+ * @return true if success or false if the eigenvalue is repeated
+ */
+static bool eigenvector(const double a[6], double l, Vector3 &vector) {
+  // Rows of A - l*I span the plane normal to the eigenvector, the largest
+  // of their cross products is the best conditioned
+  double r0[3] = {a[0] - l, a[1], a[2]};
+  double r1[3] = {a[1], a[3] - l, a[4]};
+  double r2[3] = {a[2], a[4], a[5] - l};
+  double c[3][3] = {
+    {r0[1]*r1[2] - r0[2]*r1[1], r0[2]*r1[0] - r0[0]*r1[2], r0[0]*r1[1] - r0[1]*r1[0]},
+    {r0[1]*r2[2] - r0[2]*r2[1], r0[2]*r2[0] - r0[0]*r2[2], r0[0]*r2[1] - r0[1]*r2[0]},
+    {r1[1]*r2[2] - r1[2]*r2[1], r1[2]*r2[0] - r1[0]*r2[2], r1[0]*r2[1] - r1[1]*r2[0]}};
+  int best = 0;
+  double norm = 0;
+  for(int i = 0; i < 3; ++i) {
+    double n = c[i][0]*c[i][0] + c[i][1]*c[i][1] + c[i][2]*c[i][2];
+    if(n > norm) {
+      norm = n;
+      best = i;
+    }
+  }
+  if(norm < 1e-60) {
+    return false;
+  }
+  norm = sqrt(norm);
+  vector = {(float)(c[best][0]/norm), (float)(c[best][1]/norm), (float)(c[best][2]/norm)};
+  return true;
+}
+
+NormalEstimator::NormalEstimator(ThreadPool &pool) : _pool(pool) {
+  _k = 16;
+}
+
+bool NormalEstimator::set_neighbours(size_t k) {
+  if(k < 3 || k > KDTREE_MAX_K) {
+    return false;
+  }
+  _k = k;
+  return true;
+}
+
+/**
+ * @bref  Estimate the normal and curvature of every point in parallel
+ * @param Tree over the points
+ * @param Points
+ * @param How many
+ * @param Normals out
+ * @param Curvatures out, or null
+ * @return None
+ */
+void NormalEstimator::estimate(KDTree &tree, const ScanPoint *points, size_t count, Vector3 *normals,
+  float *curvature) {
+  size_t k = _k;
+  _pool.parallel_for(count, [&tree, points, normals, curvature, k](size_t begin, size_t end, size_t) {
+    uint32_t indices[KDTREE_MAX_K];
+    float distances[KDTREE_MAX_K];
+    // In leaf order, consecutive queries walk the same nodes
+    for(size_t t = begin; t < end; ++t) {
+      size_t i = tree.get_index(t);
+      size_t found = tree.knn(points[i].position, k, indices, distances);
+      if(found < 3) {
+        normals[i] = {0, 0, 0};
+        if(curvature != nullptr) {
+          curvature[i] = 0;
+        }
+        continue;
+      }
+
+      // Covariance about the mean, relative to the point to keep the
+      // coordinates small
+      const Vector3 &o = points[i].position;
+      double mean[3] = {0, 0, 0};
+      for(size_t j = 0; j < found; ++j) {
+        Vector3 d = points[indices[j]].position - o;
+        mean[0] += d.x; mean[1] += d.y; mean[2] += d.z;
+      }
+      mean[0] /= found; mean[1] /= found; mean[2] /= found;
+      double a[6] = {0, 0, 0, 0, 0, 0};
+      for(size_t j = 0; j < found; ++j) {
+        Vector3 d = points[indices[j]].position - o;
+        double x = d.x - mean[0], y = d.y - mean[1], z = d.z - mean[2];
+        a[0] += x*x; a[1] += x*y; a[2] += x*z;
+        a[3] += y*y; a[4] += y*z; a[5] += z*z;
+      }
+
+      double values[3];
+      eigenvalues(a, values);
+      Vector3 normal = {0, 0, 0}, line;
+      Vector3 view = points[i].origin - o;
+      if(values[1] > LINE_SPREAD*values[2]) {
+        // Spread in two directions, the normal is that of least spread
+        if(eigenvector(a, values[0], normal) && normal.dot(view) < 0) {
+          normal = normal*-1.0f;
+        }
+      } else if(values[2] > 0 && eigenvector(a, values[2], line)) {
+        // Along a line, e.g. a single sweep, any direction across it fits as
+        // well: take the one facing the sensor
+        Vector3 across = view - line*view.dot(line);
+        float length = across.norm();
+        if(length > 1e-6f*view.norm()) {
+          normal = across*(1.0f/length);
+        }
+      }
+      normals[i] = normal;
+      if(curvature != nullptr) {
+        double sum = values[0] + values[1] + values[2];
+        curvature[i] = sum > 0 ? values[0]/sum : 0;
+      }
+    }
+  }, ESTIMATE_GRAIN);
+}
@@ -0,0 +1,265 @@
+#include <cmath>
+
+#include "Octree.hpp"
+
+static inline uint32_t octant(const Vector3 &p, const Vector3 &center) {
+  return (p.x >= center.x ? 1 : 0) | (p.y >= center.y ? 2 : 0) | (p.z >= center.z ? 4 : 0);
+}
+
+static inline Vector3 child_center(const Vector3 &center, float half, uint32_t octant) {
+  float q = half/2;
+  return {center.x + (octant & 1 ? q : -q), center.y + (octant & 2 ? q : -q), center.z + (octant & 4 ? q : -q)};
+}
+
+static inline bool inside(const Vector3 &p, const Vector3 &min, const Vector3 &max) {
+  return p.x >= min.x && p.x <= max.x && p.y >= min.y && p.y <= max.y && p.z >= min.z && p.z <= max.z;
+}
+
+static inline void empty_node(OctreeNode &node) {
+  node.children = OCTREE_NONE;
+  node.head = OCTREE_NONE;
+  node.count = 0;
+  node.position = {0, 0, 0};
+  node.origin = {0, 0, 0};
+  node.signal_rate = 0;
+  node.min = {INFINITY, INFINITY, INFINITY};
+  node.max = {-INFINITY, -INFINITY, -INFINITY};
+  node.newest = 0;
+}
+
+Octree::Octree(const Vector3 &center, float half_size, float min_size) {
+  _center = center;
+  _half = half_size;
+  _min_size = min_size;
+  clear();
+}
+
+/**
+ * @bref  Add points, splitting full leaves and growing the root
+ * @param Points
+ * @param How many points
+ * @return None
+ */
+void Octree::insert(const ScanPoint *points, size_t count) {
+  for(size_t i = 0; i < count; ++i) {
+    const ScanPoint &point = points[i];
+    const Vector3 &p = point.position;
+    if(!std::isfinite(p.x) || !std::isfinite(p.y) || !std::isfinite(p.z)) {
+      continue;
+    }
+    while(fabsf(p.x - _center.x) > _half || fabsf(p.y - _center.y) > _half ||
+      fabsf(p.z - _center.z) > _half) {
+      grow(p);
+    }
+
+    uint32_t index = _points.size();
+    _points.push_back(point);
+    _links.push_back(OCTREE_NONE);
+
+    uint32_t node = _root;
+    Vector3 center = _center;
+    float half = _half;
+    while(true) {
+      add(_nodes[node], point);
+      if(_nodes[node].children == OCTREE_NONE) {
+        break;
+      }
+      uint32_t o = octant(p, center);
+      node = _nodes[node].children + o;
+      center = child_center(center, half, o);
+      half /= 2;
+    }
+
+    OctreeNode &leaf = _nodes[node];
+    _links[index] = leaf.head;
+    leaf.head = index;
+    if(leaf.count > OCTREE_LEAF_CAPACITY && 2*half > _min_size) {
+      split(node, center);
+    }
+  }
+}
+
+void Octree::clear(void) {
+  _nodes.clear();
+  _points.clear();
+  _links.clear();
+  _nodes.emplace_back();
+  empty_node(_nodes.back());
+  _root = 0;
+}
+
+size_t Octree::query(const Vector3 &min, const Vector3 &max, std::vector<ScanPoint> &points) {
+  return collect(min, max, 0, points);
+}
+
+size_t Octree::query(const Vector3 &min, const Vector3 &max, float spacing, std::vector<ScanPoint> &points) {
+  return collect(min, max, spacing, points);
+}
+
+/**
+ * @bref  Count the points inside a box, whole nodes at a time where possible
+ * @param Box minimum corner
+ * @param Box maximum corner
+ * @return Points inside the box
+ */
+size_t Octree::count(const Vector3 &min, const Vector3 &max) {
+  size_t found = 0;
+  _stack.clear();
+  _stack.push_back({_root, _center, _half});
+  while(!_stack.empty()) {
+    Cell cell = _stack.back();
+    _stack.pop_back();
+    const OctreeNode &node = _nodes[cell.node];
+    if(node.count == 0 || node.min.x > max.x || node.max.x < min.x || node.min.y > max.y ||
+      node.max.y < min.y || node.min.z > max.z || node.max.z < min.z) {
+      continue;
+    }
+    if(inside(node.min, min, max) && inside(node.max, min, max)) {
+      found += node.count;
+    } else if(node.children == OCTREE_NONE) {
+      for(uint32_t i = node.head; i != OCTREE_NONE; i = _links[i]) {
+        found += inside(_points[i].position, min, max) ? 1 : 0;
+      }
+    } else {
+      for(uint32_t o = 0; o < 8; ++o) {
+        _stack.push_back({node.children + o, child_center(cell.center, cell.half, o), cell.half/2});
+      }
+    }
+  }
+  return found;
+}
+
+size_t Octree::get_point_count(void) {
+  return _points.size();
+}
+
+size_t Octree::get_node_count(void) {
+  return _nodes.size();
+}
+
+const OctreeNode &Octree::get_root(void) {
+  return _nodes[_root];
+}
+
+/**
+ * @bref  Double the root toward a point outside of it, the old root becomes
+ *        one of the children
+ * @param Point
+ * @return None
+ */
+void Octree::grow(const Vector3 &p) {
+  Vector3 center = {p.x >= _center.x ? _center.x + _half : _center.x - _half,
+    p.y >= _center.y ? _center.y + _half : _center.y - _half,
+    p.z >= _center.z ? _center.z + _half : _center.z - _half};
+
+  uint32_t children = allocate_children();
+  OctreeNode old = _nodes[_root];
+  _nodes[children + octant(_center, center)] = old;
+
+  OctreeNode &root = _nodes[_root];
+  empty_node(root);
+  root.children = children;
+  root.count = old.count;
+  root.position = old.position;
+  root.origin = old.origin;
+  root.signal_rate = old.signal_rate;
+  root.min = old.min;
+  root.max = old.max;
+  root.newest = old.newest;
+
+  _center = center;
+  _half *= 2;
+}
+
+uint32_t Octree::allocate_children(void) {
+  uint32_t first = _nodes.size();
+  _nodes.resize(first + 8);
+  for(uint32_t o = 0; o < 8; ++o) {
+    empty_node(_nodes[first + o]);
+  }
+  return first;
+}
+
+void Octree::add(OctreeNode &node, const ScanPoint &point) {
+  const Vector3 &p = point.position;
+  float w = 1.0f/++node.count;
+  node.position += (p - node.position)*w;
+  node.origin += (point.origin - node.origin)*w;
+  node.signal_rate += (point.signal_rate - node.signal_rate)*w;
+  node.min = {fminf(node.min.x, p.x), fminf(node.min.y, p.y), fminf(node.min.z, p.z)};
+  node.max = {fmaxf(node.max.x, p.x), fmaxf(node.max.y, p.y), fmaxf(node.max.z, p.z)};
+  if(point.timestamp > node.newest) {
+    node.newest = point.timestamp;
+  }
+}
+
+/**
+ * @bref  Turn a full leaf into a node, moving its points to the children
+ * @param Leaf
+ * @param Center of the leaf
+ * @return None
+ */
+void Octree::split(uint32_t node, const Vector3 &center) {
+  uint32_t children = allocate_children();
+  uint32_t i = _nodes[node].head;
+  _nodes[node].children = children;
+  _nodes[node].head = OCTREE_NONE;
+
+  while(i != OCTREE_NONE) {
+    uint32_t next = _links[i];
+    OctreeNode &child = _nodes[children + octant(_points[i].position, center)];
+    add(child, _points[i]);
+    _links[i] = child.head;
+    child.head = i;
+    i = next;
+  }
+  // With all points in one octant the child splits on its next point
+}
+
+/**
+ * @bref  Gather the points, or node representatives, inside a box
+ * @param Box minimum corner
+ * @param Box maximum corner
+ * @param Spacing, 0 for every point
+ * @param Points out, appended to
+ * @return How many were appended
+ */
+size_t Octree::collect(const Vector3 &min, const Vector3 &max, float spacing, std::vector<ScanPoint> &points) {
+  size_t found = 0;
+  _stack.clear();
+  _stack.push_back({_root, _center, _half});
+  while(!_stack.empty()) {
+    Cell cell = _stack.back();
+    _stack.pop_back();
+    const OctreeNode &node = _nodes[cell.node];
+    if(node.count == 0 || node.min.x > max.x || node.max.x < min.x || node.min.y > max.y ||
+      node.max.y < min.y || node.min.z > max.z || node.max.z < min.z) {
+      continue;
+    }
+
+    if(2*cell.half <= spacing) {
+      if(inside(node.position, min, max)) {
+        ScanPoint point;
+        point.position = node.position;
+        point.origin = node.origin;
+        point.signal_rate = node.signal_rate;
+        point.sensor = 0;
+        point.timestamp = node.newest;
+        points.push_back(point);
+        ++found;
+      }
+    } else if(node.children == OCTREE_NONE) {
+      for(uint32_t i = node.head; i != OCTREE_NONE; i = _links[i]) {
+        if(inside(_points[i].position, min, max)) {
+          points.push_back(_points[i]);
+          ++found;
+        }
+      }
+    } else {
+      for(uint32_t o = 0; o < 8; ++o) {
+        _stack.push_back({node.children + o, child_center(cell.center, cell.half, o), cell.half/2});
+      }
+    }
+  }
+  return found;
+}
@@ -0,0 +1,177 @@
+#include <cmath>
+
+#include "OutlierFilter.hpp"
+
+// Points tested at a time by a thread
+#define FILTER_GRAIN 256
+
+OutlierFilter::OutlierFilter(ThreadPool &pool) : _pool(pool), _tree(pool) {
+  _k = 8;
+  _sigma = 2.0f;
+  _radius = 0.02f;
+  _min_neighbours = 0;
+  _min_signal_rate = 0;
+}
+
+bool OutlierFilter::set_statistical(size_t k, float sigma) {
+  if(k >= KDTREE_MAX_K || !(sigma > 0)) {
+    return false;
+  }
+  _k = k;
+  _sigma = sigma;
+  return true;
+}
+
+bool OutlierFilter::set_radius(float radius, size_t min_neighbours) {
+  if(!(radius > 0)) {
+    return false;
+  }
+  _radius = radius;
+  _min_neighbours = min_neighbours;
+  return true;
+}
+
+bool OutlierFilter::set_min_signal_rate(float signal_rate) {
+  if(signal_rate < 0) {
+    return false;
+  }
+  _min_signal_rate = signal_rate;
+  return true;
+}
+
+/**
+ * @bref  Run the enabled tests one after the other
+ * @param Points
+ * @param How many
+ * @param Flags out, 1 to keep a point
+ * @return How many points are kept
+ */
+size_t OutlierFilter::filter(const ScanPoint *points, size_t count, uint8_t *keep) {
+  for(size_t i = 0; i < count; ++i) {
+    keep[i] = points[i].signal_rate >= _min_signal_rate ? 1 : 0;
+  }
+
+  std::vector<uint32_t> kept;
+  if(_k > 0) {
+    gather(points, count, keep, kept);
+    statistical(points, kept, keep);
+  }
+  if(_min_neighbours > 0) {
+    gather(points, count, keep, kept);
+    radius(points, kept, keep);
+  }
+
+  size_t n = 0;
+  for(size_t i = 0; i < count; ++i) {
+    n += keep[i];
+  }
+  return n;
+}
+
+size_t OutlierFilter::filter(std::vector<ScanPoint> &points) {
+  std::vector<uint8_t> keep(points.size());
+  filter(points.data(), points.size(), keep.data());
+
+  size_t n = 0;
+  for(size_t i = 0; i < points.size(); ++i) {
+    if(keep[i]) {
+      points[n++] = points[i];
+    }
+  }
+  points.resize(n);
+  return n;
+}
+
+void OutlierFilter::gather(const ScanPoint *points, size_t count, const uint8_t *keep,
+  std::vector<uint32_t> &kept) {
+  kept.clear();
+  std::vector<Vector3> positions;
+  for(size_t i = 0; i < count; ++i) {
+    if(keep[i]) {
+      kept.push_back(i);
+      positions.push_back(points[i].position);
+    }
+  }
+  _tree.build(positions.data(), positions.size());
+}
+
+/**
+ * @bref  Drop the points far from their neighbours compared with the others
+ * @param Points
+ * @param Indexes of the points still kept, as in the tree
+ * @param Flags to clear
+ * @return None
+ */
+void OutlierFilter::statistical(const ScanPoint *points, const std::vector<uint32_t> &kept, uint8_t *keep) {
+  size_t count = kept.size();
+  size_t k = _k + 1;
+  if(count < k) {
+    return;
+  }
+
+  std::vector<float> mean_distances(count);
+  std::vector<double> sums(_pool.size(), 0), squares(_pool.size(), 0);
+  _pool.parallel_for(count, [&](size_t begin, size_t end, size_t thread) {
+    uint32_t indices[KDTREE_MAX_K];
+    float distances[KDTREE_MAX_K];
+    double sum = 0, square = 0;
+    // In leaf order, consecutive queries walk the same nodes
+    for(size_t t = begin; t < end; ++t) {
+      size_t i = _tree.get_index(t);
+      size_t found = _tree.knn(points[kept[i]].position, k, indices, distances);
+      // The nearest is the point itself
+      float d = 0;
+      for(size_t j = 1; j < found; ++j) {
+        d += sqrtf(distances[j]);
+      }
+      d /= found - 1;
+      mean_distances[i] = d;
+      sum += d;
+      square += (double)d*d;
+    }
+    sums[thread] += sum;
+    squares[thread] += square;
+  }, FILTER_GRAIN);
+
+  double sum = 0, square = 0;
+  for(size_t t = 0; t < sums.size(); ++t) {
+    sum += sums[t];
+    square += squares[t];
+  }
+  double mean = sum/count;
+  double deviation = sqrt(fmax(square/count - mean*mean, 0));
+  float limit = mean + _sigma*deviation;
+
+  for(size_t i = 0; i < count; ++i) {
+    if(mean_distances[i] > limit) {
+      keep[kept[i]] = 0;
+    }
+  }
+}
+
+/**
+ * @bref  Drop the points with too few neighbours
+ * @param Points
+ * @param Indexes of the points still kept, as in the tree
+ * @param Flags to clear
+ * @return None
+ */
+void OutlierFilter::radius(const ScanPoint *points, const std::vector<uint32_t> &kept, uint8_t *keep) {
+  std::vector<uint8_t> isolated(kept.size(), 0);
+
+  _pool.parallel_for(kept.size(), [&](size_t begin, size_t end, size_t) {
+    for(size_t t = begin; t < end; ++t) {
+      size_t i = _tree.get_index(t);
+      // The point itself is among them
+      size_t found = _tree.count(points[kept[i]].position, _radius, _min_neighbours + 1);
+      isolated[i] = found < _min_neighbours + 1 ? 1 : 0;
+    }
+  }, FILTER_GRAIN);
+
+  // Cleared afterwards, all points count as neighbours during the test
+  for(size_t i = 0; i < kept.size(); ++i) {
+    if(isolated[i]) {
+      keep[kept[i]] = 0;
+    }
+  }
+}
@@ -0,0 +1,341 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <endian.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "PointCloudWriter.hpp"
+
+// Bytes per point: x, y, z, intensity
+#define POINT_SIZE 16
+
+// Digits of the point count in the header
+#define COUNT_DIGITS 10
+
+static const char ply_header[] =
+  "ply\n"
+  "format binary_little_endian 1.0\n"
+  "element vertex %s\n"
+  "property float x\n"
+  "property float y\n"
+  "property float z\n"
+  "property float intensity\n"
+  "end_header\n";
+
+static const char pcd_header[] =
+  "# .PCD v0.7 - Point Cloud Data file format\n"
+  "VERSION 0.7\n"
+  "FIELDS x y z intensity\n"
+  "SIZE 4 4 4 4\n"
+  "TYPE F F F F\n"
+  "COUNT 1 1 1 1\n"
+  "WIDTH %s\n"
+  "HEIGHT 1\n"
+  "VIEWPOINT 0 0 0 1 0 0 0\n"
+  "POINTS %s\n"
+  "DATA binary\n";
+
+static inline void put_float(uint8_t *p, float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  bits = htole32(bits);
+  memcpy(p, &bits, sizeof(bits));
+}
+
+PointCloudWriter::PointCloudWriter() {
+  _fd = -1;
+  _current = nullptr;
+  _used = 0;
+  _stopping = false;
+  _failed = false;
+  _points = 0;
+}
+
+PointCloudWriter::~PointCloudWriter() {
+  close();
+}
+
+/**
+ * @bref  Create the file, allocate the buffers and start the writer thread
+ * @param File path
+ * @param PLY or PCD
+ * @param Whether to bypass the page cache with O_DIRECT
+ * @param When to fdatasync
+ * @param Size of each buffer in bytes
+ * @param How many buffers
+ * @return true if success or false if don't
+ */
+bool PointCloudWriter::open(const std::string &path, PointCloudFormat format, bool direct,
+  PointCloudSync sync, size_t buffer_size, size_t buffers) {
+  if(_fd >= 0) {
+    return false;
+  }
+
+  _direct = direct;
+  _fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | (direct ? O_DIRECT : 0), 0644);
+  if(_fd < 0 && direct) {
+    // tmpfs and some FUSE filesystems refuse O_DIRECT
+    _direct = false;
+    _fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  }
+  if(_fd < 0) {
+    perror("Failed to open point cloud file");
+    return false;
+  }
+
+  _format = format;
+  _sync = sync;
+  _buffer_size = (buffer_size + POINT_CLOUD_ALIGNMENT - 1)/POINT_CLOUD_ALIGNMENT*POINT_CLOUD_ALIGNMENT;
+  if(buffers < 2) {
+    buffers = 2;
+  }
+  for(size_t i = 0; i < buffers; ++i) {
+    void *buffer;
+    if(posix_memalign(&buffer, POINT_CLOUD_ALIGNMENT, _buffer_size) != 0) {
+      perror("Failed to allocate point cloud buffer");
+      close();
+      return false;
+    }
+    _buffers.push_back((uint8_t *)buffer);
+    _free.push_back((uint8_t *)buffer);
+  }
+
+  _current = _free.back();
+  _free.pop_back();
+  _used = 0;
+  _points = 0;
+  _stopping = false;
+  _failed = false;
+  write_header();
+
+  _thread = std::thread(&PointCloudWriter::run, this);
+  return true;
+}
+
+/**
+ * @bref  Pack points into the buffers
+ * @param Points
+ * @param How many points
+ * @return true if success or false if a write already failed
+ */
+bool PointCloudWriter::write(const ScanPoint *points, size_t count) {
+  if(_fd < 0 || _failed) {
+    return false;
+  }
+
+  for(size_t i = 0; i < count; ++i) {
+    uint8_t record[POINT_SIZE];
+    uint8_t *p = _buffer_size - _used >= POINT_SIZE ? _current + _used : record;
+    put_float(p, points[i].position.x);
+    put_float(p + 4, points[i].position.y);
+    put_float(p + 8, points[i].position.z);
+    put_float(p + 12, points[i].signal_rate);
+
+    if(p == record) {
+      // The header shifted the records off the buffer boundaries, split this one
+      size_t head = _buffer_size - _used;
+      memcpy(_current + _used, record, head);
+      _used = _buffer_size;
+      submit();
+      memcpy(_current, record + head, POINT_SIZE - head);
+      _used = POINT_SIZE - head;
+    } else {
+      _used += POINT_SIZE;
+      if(_used == _buffer_size) {
+        submit();
+      }
+    }
+  }
+  _points += count;
+
+  return !_failed;
+}
+
+/**
+ * @bref  Drain the buffers, write the tail, patch the counts and close
+ * @param None
+ * @return true if everything was written or false if don't
+ */
+bool PointCloudWriter::close(void) {
+  if(_fd < 0) {
+    return false;
+  }
+
+  if(_thread.joinable()) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _stopping = true;
+    lock.unlock();
+    _full_ready.notify_one();
+    _thread.join();
+  }
+
+  bool b = !_failed;
+  if(_direct) {
+    // The tail and the header patch are neither aligned nor full blocks
+    int flags = fcntl(_fd, F_GETFL);
+    fcntl(_fd, F_SETFL, flags & ~O_DIRECT);
+  }
+  if(b && _current != nullptr && _used > 0) {
+    b = write_all(_fd, _current, _used);
+  }
+
+  char count[COUNT_DIGITS + 1];
+  snprintf(count, sizeof(count), "%0*llu", COUNT_DIGITS, (unsigned long long)_points);
+  for(size_t offset : _count_offsets) {
+    b = b && pwrite(_fd, count, COUNT_DIGITS, offset) == COUNT_DIGITS;
+  }
+
+  if(b && _sync != SYNC_NONE) {
+    b = fdatasync(_fd) == 0;
+  }
+  if(!b) {
+    perror("Failed to write point cloud file");
+  }
+  ::close(_fd);
+  _fd = -1;
+
+  for(uint8_t *buffer : _buffers) {
+    free(buffer);
+  }
+  _buffers.clear();
+  _free.clear();
+  _full.clear();
+  _current = nullptr;
+  _count_offsets.clear();
+
+  return b;
+}
+
+uint64_t PointCloudWriter::get_points_written(void) {
+  return _points;
+}
+
+bool PointCloudWriter::is_open(void) {
+  return _fd >= 0;
+}
+
+/**
+ * @bref  Put the header at the start of the first buffer, remembering where
+ *        the counts go
+ * @param None
+ * @return None
+ */
+void PointCloudWriter::write_header(void) {
+  std::string placeholder(COUNT_DIGITS, '0');
+  const char *templ = _format == FORMAT_PLY ? ply_header : pcd_header;
+
+  std::string header;
+  for(const char *c = templ; *c != '\0'; ++c) {
+    if(c[0] == '%' && c[1] == 's') {
+      _count_offsets.push_back(header.size());
+      header += placeholder;
+      ++c;
+    } else {
+      header += *c;
+    }
+  }
+
+  memcpy(_current, header.data(), header.size());
+  _used = header.size();
+}
+
+void PointCloudWriter::submit(void) {
+  std::unique_lock<std::mutex> lock(_mutex);
+  _full.emplace_back(_current, _used);
+  _full_ready.notify_one();
+
+  _free_ready.wait(lock, [this]() {
+    return !_free.empty();
+  });
+  _current = _free.back();
+  _free.pop_back();
+  _used = 0;
+}
+
+/**
+ * @bref  Writer thread, flushes every pending buffer with one writev
+ * @param None
+ * @return None
+ */
+void PointCloudWriter::run(void) {
+  std::vector<std::pair<uint8_t *, size_t>> pending;
+  std::vector<iovec> iov;
+
+  while(true) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _full_ready.wait(lock, [this]() {
+      return _stopping || !_full.empty();
+    });
+    if(_full.empty()) {
+      return;
+    }
+    while(!_full.empty() && pending.size() < IOV_MAX) {
+      pending.push_back(_full.front());
+      _full.pop_front();
+    }
+    lock.unlock();
+
+    iov.clear();
+    size_t total = 0;
+    for(auto &buffer : pending) {
+      iov.push_back({buffer.first, buffer.second});
+      total += buffer.second;
+    }
+
+    size_t done = 0;
+    size_t first = 0;
+    while(!_failed && done < total) {
+      ssize_t n = writev(_fd, &iov[first], iov.size() - first);
+      if(n < 0) {
+        if(errno == EINTR) {
+          continue;
+        }
+        perror("Failed to write point cloud file");
+        _failed = true;
+        break;
+      }
+      done += n;
+      // Skip what was written, a short write may end inside a buffer
+      while(first < iov.size() && (size_t)n >= iov[first].iov_len) {
+        n -= iov[first].iov_len;
+        ++first;
+      }
+      if(first < iov.size()) {
+        iov[first].iov_base = (uint8_t *)iov[first].iov_base + n;
+        iov[first].iov_len -= n;
+      }
+    }
+    if(!_failed && _sync == SYNC_EVERY_FLUSH && fdatasync(_fd) != 0) {
+      perror("Failed to sync point cloud file");
+      _failed = true;
+    }
+
+    lock.lock();
+    for(auto &buffer : pending) {
+      _free.push_back(buffer.first);
+    }
+    pending.clear();
+    lock.unlock();
+    _free_ready.notify_one();
+  }
+}
+
+bool PointCloudWriter::write_all(int fd, const void *data, size_t length) {
+  const uint8_t *p = (const uint8_t *)data;
+  while(length > 0) {
+    ssize_t n = ::write(fd, p, length);
+    if(n < 0) {
+      if(errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    p += n;
+    length -= n;
+  }
+  return true;
+}
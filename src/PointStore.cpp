@@ -0,0 +1,435 @@
+#include <cmath>
+#include <cstdio>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "PointStore.hpp"
+
+static const char header_magic[8] = {'P', 'T', 'S', 'T', 'O', 'R', 'E', '1'};
+static const char footer_magic[8] = {'P', 'T', 'I', 'N', 'D', 'E', 'X', '1'};
+
+#define CHUNK_MAGIC 0x4b4e4843
+#define BYTE_ORDER_MARK 0x01020304
+#define STORE_VERSION 1
+
+static_assert(sizeof(PointStoreChunk) == 64, "PointStoreChunk must stay 64 bytes");
+static_assert(sizeof(PointStoreHeader) <= POINT_STORE_HEADER_SIZE, "PointStoreHeader too large");
+
+static inline bool overlaps(const PointStoreChunk &chunk, const Vector3 &min, const Vector3 &max,
+  uint64_t time_min, uint64_t time_max) {
+  return chunk.min.x <= max.x && chunk.max.x >= min.x &&
+    chunk.min.y <= max.y && chunk.max.y >= min.y &&
+    chunk.min.z <= max.z && chunk.max.z >= min.z &&
+    chunk.time_min <= time_max && chunk.time_max >= time_min;
+}
+
+static inline bool inside(const ScanPoint &point, const Vector3 &min, const Vector3 &max,
+  uint64_t time_min, uint64_t time_max) {
+  const Vector3 &p = point.position;
+  return p.x >= min.x && p.x <= max.x && p.y >= min.y && p.y <= max.y &&
+    p.z >= min.z && p.z <= max.z && point.timestamp >= time_min && point.timestamp <= time_max;
+}
+
+PointStoreWriter::PointStoreWriter() {
+  _fd = -1;
+  _window = nullptr;
+  _points = 0;
+}
+
+PointStoreWriter::~PointStoreWriter() {
+  close();
+}
+
+/**
+ * @bref  Create the store and write its header
+ * @param File path
+ * @param Points per chunk
+ * @return true if success or false if don't
+ */
+bool PointStoreWriter::open(const std::string &path, uint32_t chunk_points) {
+  if(_fd >= 0 || chunk_points == 0) {
+    return false;
+  }
+
+  _fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if(_fd < 0) {
+    perror("Failed to open point store");
+    return false;
+  }
+
+  // Chunks are a whole number of pages so each window maps at a page boundary
+  size_t page = sysconf(_SC_PAGESIZE);
+  _chunk_points = chunk_points;
+  _chunk_size = sizeof(PointStoreChunk) + (uint64_t)chunk_points*sizeof(ScanPoint);
+  _chunk_size = (_chunk_size + page - 1)/page*page;
+  _end = (POINT_STORE_HEADER_SIZE + page - 1)/page*page;
+  _points = 0;
+  _index.clear();
+
+  PointStoreHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, header_magic, sizeof(header.magic));
+  header.byte_order = BYTE_ORDER_MARK;
+  header.version = STORE_VERSION;
+  header.point_size = sizeof(ScanPoint);
+  header.chunk_points = _chunk_points;
+  header.chunk_size = _chunk_size;
+  header.first_chunk = _end;
+  if(pwrite(_fd, &header, sizeof(header), 0) != sizeof(header)) {
+    perror("Failed to write point store header");
+    ::close(_fd);
+    _fd = -1;
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * @bref  Copy points into the chunks, mapping a new one when full
+ * @param Points
+ * @param How many points
+ * @return true if success or false if don't
+ */
+bool PointStoreWriter::append(const ScanPoint *points, size_t count) {
+  if(_fd < 0) {
+    return false;
+  }
+
+  while(count > 0) {
+    if(_window == nullptr && !map_chunk()) {
+      return false;
+    }
+
+    size_t n = _chunk_points - _chunk.count;
+    if(n > count) {
+      n = count;
+    }
+    ScanPoint *dst = (ScanPoint *)(_window + sizeof(PointStoreChunk)) + _chunk.count;
+    memcpy(dst, points, n*sizeof(ScanPoint));
+
+    for(size_t i = 0; i < n; ++i) {
+      const Vector3 &p = points[i].position;
+      _chunk.min.x = fminf(_chunk.min.x, p.x); _chunk.max.x = fmaxf(_chunk.max.x, p.x);
+      _chunk.min.y = fminf(_chunk.min.y, p.y); _chunk.max.y = fmaxf(_chunk.max.y, p.y);
+      _chunk.min.z = fminf(_chunk.min.z, p.z); _chunk.max.z = fmaxf(_chunk.max.z, p.z);
+      if(points[i].timestamp < _chunk.time_min) {
+        _chunk.time_min = points[i].timestamp;
+      }
+      if(points[i].timestamp > _chunk.time_max) {
+        _chunk.time_max = points[i].timestamp;
+      }
+    }
+
+    _chunk.count += n;
+    _points += n;
+    points += n;
+    count -= n;
+
+    if(_chunk.count == _chunk_points && !unmap_chunk()) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/**
+ * @bref  Complete the last chunk, write the index and the footer
+ * @param None
+ * @return true if success or false if don't
+ */
+bool PointStoreWriter::close(void) {
+  if(_fd < 0) {
+    return false;
+  }
+
+  bool b = _window == nullptr || unmap_chunk();
+
+  PointStoreFooter footer;
+  memset(&footer, 0, sizeof(footer));
+  footer.index_offset = _end;
+  footer.chunks = _index.size();
+  footer.points = _points;
+  memcpy(footer.magic, footer_magic, sizeof(footer.magic));
+
+  size_t index_size = _index.size()*sizeof(PointStoreIndexEntry);
+  b = b && pwrite(_fd, _index.data(), index_size, _end) == (ssize_t)index_size;
+  b = b && pwrite(_fd, &footer, sizeof(footer), _end + index_size) == sizeof(footer);
+  if(!b) {
+    perror("Failed to write point store index");
+  }
+
+  ::close(_fd);
+  _fd = -1;
+  return b;
+}
+
+uint64_t PointStoreWriter::get_points_written(void) {
+  return _points;
+}
+
+/**
+ * @bref  Grow the file by a chunk and map it
+ * @param None
+ * @return true if success or false if don't
+ */
+bool PointStoreWriter::map_chunk(void) {
+  // Pages past the end of the file can't be mapped, the new ones stay a hole
+  // until written
+  if(ftruncate(_fd, _end + _chunk_size) != 0) {
+    perror("Failed to grow point store");
+    return false;
+  }
+  void *window = mmap(nullptr, _chunk_size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, _end);
+  if(window == MAP_FAILED) {
+    perror("Failed to map point store chunk");
+    return false;
+  }
+  // Filled front to back, never read
+  madvise(window, _chunk_size, MADV_SEQUENTIAL);
+
+  _window = (uint8_t *)window;
+  memset(&_chunk, 0, sizeof(_chunk));
+  _chunk.magic = CHUNK_MAGIC;
+  _chunk.min = {INFINITY, INFINITY, INFINITY};
+  _chunk.max = {-INFINITY, -INFINITY, -INFINITY};
+  _chunk.time_min = UINT64_MAX;
+  _chunk.time_max = 0;
+  return true;
+}
+
+/**
+ * @bref  Write the chunk header, unmap it and record it in the index
+ * @param None
+ * @return true if success or false if don't
+ */
+bool PointStoreWriter::unmap_chunk(void) {
+  memcpy(_window, &_chunk, sizeof(_chunk));
+  // Start the writeback now rather than when the page cache fills up
+  msync(_window, _chunk_size, MS_ASYNC);
+  bool b = munmap(_window, _chunk_size) == 0;
+  _window = nullptr;
+
+  _index.push_back({_end, _chunk});
+  _end += _chunk_size;
+  return b;
+}
+
+PointStoreReader::PointStoreReader() {
+  _map = nullptr;
+  _size = 0;
+  _points = 0;
+  _recovered = false;
+}
+
+PointStoreReader::~PointStoreReader() {
+  close();
+}
+
+/**
+ * @bref  Map a store and load its index
+ * @param File path
+ * @return true if success or false if the file isn't a store
+ */
+bool PointStoreReader::open(const std::string &path) {
+  close();
+
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if(fd < 0) {
+    perror("Failed to open point store");
+    return false;
+  }
+  struct stat st;
+  if(fstat(fd, &st) != 0 || st.st_size < POINT_STORE_HEADER_SIZE) {
+    ::close(fd);
+    return false;
+  }
+  _size = st.st_size;
+  void *map = mmap(nullptr, _size, PROT_READ, MAP_SHARED, fd, 0);
+  // The mapping keeps the file
+  ::close(fd);
+  if(map == MAP_FAILED) {
+    perror("Failed to map point store");
+    return false;
+  }
+  _map = (const uint8_t *)map;
+  // Queries jump between chunks
+  madvise(map, _size, MADV_RANDOM);
+
+  if(!load_index()) {
+    close();
+    return false;
+  }
+  return true;
+}
+
+void PointStoreReader::close(void) {
+  if(_map != nullptr) {
+    munmap((void *)_map, _size);
+  }
+  _map = nullptr;
+  _size = 0;
+  _index.clear();
+  _points = 0;
+  _recovered = false;
+}
+
+size_t PointStoreReader::get_chunk_count(void) {
+  return _index.size();
+}
+
+uint64_t PointStoreReader::get_point_count(void) {
+  return _points;
+}
+
+bool PointStoreReader::is_recovered(void) {
+  return _recovered;
+}
+
+const PointStoreChunk &PointStoreReader::get_chunk(size_t chunk) {
+  return _index[chunk].chunk;
+}
+
+const ScanPoint *PointStoreReader::get_points(size_t chunk) {
+  return (const ScanPoint *)(_map + _index[chunk].offset + sizeof(PointStoreChunk));
+}
+
+/**
+ * @bref  Select chunks by their bounds and time range
+ * @param Box minimum corner
+ * @param Box maximum corner
+ * @param Start time
+ * @param End time
+ * @param Chunk indexes out
+ * @return How many chunks were found
+ */
+size_t PointStoreReader::find_chunks(const Vector3 &min, const Vector3 &max, uint64_t time_min,
+  uint64_t time_max, std::vector<size_t> &chunks) {
+  chunks.clear();
+  for(size_t i = 0; i < _index.size(); ++i) {
+    const PointStoreChunk &chunk = _index[i].chunk;
+    if(chunk.count > 0 && overlaps(chunk, min, max, time_min, time_max)) {
+      chunks.push_back(i);
+      madvise((void *)(_map + _index[i].offset), sizeof(PointStoreChunk) + chunk.count*sizeof(ScanPoint),
+        MADV_WILLNEED);
+    }
+  }
+  return chunks.size();
+}
+
+/**
+ * @bref  Copy out the points inside a box and a time range
+ * @param Box minimum corner
+ * @param Box maximum corner
+ * @param Start time
+ * @param End time
+ * @param Points out, appended to
+ * @return How many points were appended
+ */
+size_t PointStoreReader::query(const Vector3 &min, const Vector3 &max, uint64_t time_min,
+  uint64_t time_max, std::vector<ScanPoint> &points) {
+  std::vector<size_t> chunks;
+  find_chunks(min, max, time_min, time_max, chunks);
+
+  size_t found = 0;
+  for(size_t c : chunks) {
+    const PointStoreChunk &chunk = _index[c].chunk;
+    const ScanPoint *p = get_points(c);
+    bool contained = chunk.min.x >= min.x && chunk.max.x <= max.x && chunk.min.y >= min.y &&
+      chunk.max.y <= max.y && chunk.min.z >= min.z && chunk.max.z <= max.z &&
+      chunk.time_min >= time_min && chunk.time_max <= time_max;
+    if(contained) {
+      points.insert(points.end(), p, p + chunk.count);
+      found += chunk.count;
+      continue;
+    }
+    for(size_t i = 0; i < chunk.count; ++i) {
+      if(inside(p[i], min, max, time_min, time_max)) {
+        points.push_back(p[i]);
+        ++found;
+      }
+    }
+  }
+  return found;
+}
+
+/**
+ * @bref  Check the header and read the index from the footer, or rebuild it
+ * @param None
+ * @return true if success or false if the file isn't a store
+ */
+bool PointStoreReader::load_index(void) {
+  PointStoreHeader header;
+  memcpy(&header, _map, sizeof(header));
+  if(memcmp(header.magic, header_magic, sizeof(header.magic)) != 0 ||
+    header.byte_order != BYTE_ORDER_MARK || header.version != STORE_VERSION ||
+    header.point_size != sizeof(ScanPoint) || header.chunk_size < sizeof(PointStoreChunk) ||
+    header.chunk_points > (header.chunk_size - sizeof(PointStoreChunk))/sizeof(ScanPoint)) {
+    fprintf(stderr, "Not a point store of this machine\n");
+    return false;
+  }
+
+  if(_size >= POINT_STORE_HEADER_SIZE + sizeof(PointStoreFooter)) {
+    PointStoreFooter footer;
+    memcpy(&footer, _map + _size - sizeof(footer), sizeof(footer));
+    uint64_t index_size = footer.chunks*sizeof(PointStoreIndexEntry);
+    if(memcmp(footer.magic, footer_magic, sizeof(footer.magic)) == 0 &&
+      footer.chunks <= _size/sizeof(PointStoreIndexEntry) && footer.index_offset <= _size &&
+      footer.index_offset + index_size + sizeof(footer) == _size) {
+      const PointStoreIndexEntry *index = (const PointStoreIndexEntry *)(_map + footer.index_offset);
+      _index.assign(index, index + footer.chunks);
+      if(check_index(header, footer.points)) {
+        _points = footer.points;
+        return true;
+      }
+      fprintf(stderr, "Corrupt point store index, walking the chunks\n");
+      _index.clear();
+    }
+  }
+
+  recover_index(header);
+  return true;
+}
+
+/**
+ * @bref  Check every entry of an index read from the footer the way
+ *        recover_index does, so no chunk reaches past the mapping
+ * @param File header
+ * @param Points the footer claims
+ * @return true if every entry is a whole chunk in the file
+ */
+bool PointStoreReader::check_index(const PointStoreHeader &header, uint64_t points) {
+  uint64_t total = 0;
+  for(const PointStoreIndexEntry &entry : _index) {
+    if(entry.offset < header.first_chunk || entry.offset > _size ||
+      header.chunk_size > _size - entry.offset || entry.chunk.magic != CHUNK_MAGIC ||
+      entry.chunk.count > header.chunk_points) {
+      return false;
+    }
+    total += entry.chunk.count;
+  }
+  return total == points;
+}
+
+/**
+ * @bref  Walk the chunks of an unfinished store, up to the first incomplete one
+ * @param File header
+ * @return None
+ */
+void PointStoreReader::recover_index(const PointStoreHeader &header) {
+  _recovered = true;
+  for(uint64_t offset = header.first_chunk; offset + header.chunk_size <= _size;
+    offset += header.chunk_size) {
+    PointStoreChunk chunk;
+    memcpy(&chunk, _map + offset, sizeof(chunk));
+    if(chunk.magic != CHUNK_MAGIC || chunk.count > header.chunk_points) {
+      break;
+    }
+    _index.push_back({offset, chunk});
+    _points += chunk.count;
+  }
+}
@@ -0,0 +1,638 @@
+#include <cmath>
+
+#include "PoissonReconstructor.hpp"
+#include "TSDFVolume.hpp"
+
+#define B TSDF_BLOCK_SIZE
+#define BLOCK_NODES TSDF_BLOCK_VOXELS
+
+#define KEY_BITS 21
+#define KEY_OFFSET (1 << (KEY_BITS - 1))
+#define KEY_MASK ((1ULL << KEY_BITS) - 1)
+
+#define NONE UINT32_MAX
+
+// Nodes handled at a time by a thread
+#define NODE_GRAIN 4096
+
+// Depth of the dense coarse level at most, 64 cells across
+#define COARSE_MAX_DEPTH 6
+// Nodes of the coarse level past the cloud on each side, where an open
+// scan gets closed
+#define COARSE_PADDING 4
+
+// Value of the skin blocks, a full step of the indicator away from the iso
+// level
+#define SKIN_VALUE 0.5f
+
+static inline int32_t floor_div(int32_t a, int32_t b) {
+  return a >= 0 ? a/b : -((-a + b - 1)/b);
+}
+
+static inline uint64_t block_key(int32_t x, int32_t y, int32_t z) {
+  return ((uint64_t)(x + KEY_OFFSET) & KEY_MASK) << (2*KEY_BITS) |
+    ((uint64_t)(y + KEY_OFFSET) & KEY_MASK) << KEY_BITS | ((uint64_t)(z + KEY_OFFSET) & KEY_MASK);
+}
+
+static inline int slot(int dx, int dy, int dz) {
+  return (dx + 1) + 3*((dy + 1) + 3*(dz + 1));
+}
+
+PoissonReconstructor::PoissonReconstructor(ThreadPool &pool) : _pool(pool) {
+  _depth = 8;
+  _alpha = 4.0f;
+  _signal_reference = 2.0f;
+  _max_iterations = 500;
+  _tolerance = 1e-4f;
+  _coarse.cell = _fine.cell = 0;
+  _coarse.iso = _fine.iso = 0;
+  _iterations = 0;
+  _residual = 0;
+}
+
+bool PoissonReconstructor::set_depth(int depth) {
+  if(depth < 3 || depth > 10) {
+    return false;
+  }
+  _depth = depth;
+  return true;
+}
+
+bool PoissonReconstructor::set_screening(float alpha) {
+  if(alpha < 0) {
+    return false;
+  }
+  _alpha = alpha;
+  return true;
+}
+
+bool PoissonReconstructor::set_signal_reference(float signal_rate) {
+  if(!(signal_rate > 0)) {
+    return false;
+  }
+  _signal_reference = signal_rate;
+  return true;
+}
+
+bool PoissonReconstructor::set_solver(size_t max_iterations, float tolerance) {
+  if(max_iterations == 0 || !(tolerance > 0)) {
+    return false;
+  }
+  _max_iterations = max_iterations;
+  _tolerance = tolerance;
+  return true;
+}
+
+/**
+ * @bref  Solve for the indicator function and mesh its iso surface
+ * @param Points
+ * @param Unit normals pointing out of the surface, toward the sensor
+ * @param How many
+ * @param Mesh out
+ * @return true if success or false if there is nothing to reconstruct
+ */
+bool PoissonReconstructor::reconstruct(const ScanPoint *points, const Vector3 *normals, size_t count,
+  Mesh &mesh) {
+  mesh.vertices.clear();
+  mesh.triangles.clear();
+  if(count == 0) {
+    return false;
+  }
+
+  Vector3 min = points[0].position, max = min;
+  for(size_t i = 1; i < count; ++i) {
+    const Vector3 &p = points[i].position;
+    min = {fminf(min.x, p.x), fminf(min.y, p.y), fminf(min.z, p.z)};
+    max = {fmaxf(max.x, p.x), fmaxf(max.y, p.y), fmaxf(max.z, p.z)};
+  }
+  Vector3 extent = max - min;
+  float side = fmaxf(extent.x, fmaxf(extent.y, extent.z));
+  if(!(side > 0)) {
+    return false;
+  }
+
+  // A coarse cell covers ratio fine blocks along each axis
+  int coarse_depth = _depth - 3 < COARSE_MAX_DEPTH ? _depth - 3 : COARSE_MAX_DEPTH;
+  int ratio = 1 << (_depth - 3 - coarse_depth);
+  _coarse.cell = side/(1 << coarse_depth);
+  build_dense(_coarse, min, max);
+  if(!solve_level(_coarse, nullptr, points, normals, count)) {
+    return false;
+  }
+
+  _fine.cell = side/(1 << _depth);
+  build_blocks(_fine, points, count);
+  add_crossings(ratio);
+  link_blocks(_fine);
+  // Unconverged, the fine border needn't agree with the signs of the skin
+  if(!solve_level(_fine, &_coarse, points, normals, count)) {
+    return false;
+  }
+
+  TSDFVolume volume(_pool, _fine.cell);
+  TSDFVoxel voxels[BLOCK_NODES];
+  for(size_t b = 0; b < _fine.blocks.size(); ++b) {
+    for(size_t v = 0; v < BLOCK_NODES; ++v) {
+      voxels[v] = {_fine.chi[b*BLOCK_NODES + v] - _fine.iso, 1.0f};
+    }
+    volume.set_block(_fine.blocks[b].x, _fine.blocks[b].y, _fine.blocks[b].z, voxels);
+  }
+
+  // The skin closes the surface where it leaves the fine blocks, the blocks
+  // past it are on the same side so no cube there is crossed
+  for(const Block &block : _fine.blocks) {
+    for(int n = 0; n < 27; ++n) {
+      int32_t x = block.x + n % 3 - 1, y = block.y + n / 3 % 3 - 1, z = block.z + n / 9 - 1;
+      if(block.neighbours[n] != NONE || volume.find_block(x, y, z) != nullptr) {
+        continue;
+      }
+      float value = SKIN_VALUE*coarse_side(x, y, z, ratio);
+      for(size_t v = 0; v < BLOCK_NODES; ++v) {
+        voxels[v] = {value, 1.0f};
+      }
+      volume.set_block(x, y, z, voxels);
+    }
+  }
+
+  MeshExtractor extractor(volume, _pool);
+  extractor.extract(mesh);
+
+  return true;
+}
+
+size_t PoissonReconstructor::get_nodes(void) {
+  return _fine.chi.size();
+}
+
+size_t PoissonReconstructor::get_iterations(void) {
+  return _iterations;
+}
+
+float PoissonReconstructor::get_residual(void) {
+  return _residual;
+}
+
+/**
+ * @bref  Allocate every block over the cloud padded by COARSE_PADDING
+ *        nodes
+ * @param Level
+ * @param Corners of the cloud
+ * @return None
+ */
+void PoissonReconstructor::build_dense(Level &level, const Vector3 &min, const Vector3 &max) {
+  level.blocks.clear();
+  level.block_indexes.clear();
+
+  int32_t x0 = floor_div((int32_t)floorf(min.x/level.cell) - COARSE_PADDING, B);
+  int32_t y0 = floor_div((int32_t)floorf(min.y/level.cell) - COARSE_PADDING, B);
+  int32_t z0 = floor_div((int32_t)floorf(min.z/level.cell) - COARSE_PADDING, B);
+  int32_t x1 = floor_div((int32_t)floorf(max.x/level.cell) + COARSE_PADDING, B);
+  int32_t y1 = floor_div((int32_t)floorf(max.y/level.cell) + COARSE_PADDING, B);
+  int32_t z1 = floor_div((int32_t)floorf(max.z/level.cell) + COARSE_PADDING, B);
+  for(int32_t z = z0; z <= z1; ++z) {
+    for(int32_t y = y0; y <= y1; ++y) {
+      for(int32_t x = x0; x <= x1; ++x) {
+        add_block(level, x, y, z);
+      }
+    }
+  }
+  link_blocks(level);
+}
+
+/**
+ * @bref  Allocate the blocks holding points and every block around them
+ * @param Level
+ * @param Points
+ * @param How many
+ * @return None
+ */
+void PoissonReconstructor::build_blocks(Level &level, const ScanPoint *points, size_t count) {
+  level.blocks.clear();
+  level.block_indexes.clear();
+
+  uint64_t last = UINT64_MAX;
+  for(size_t i = 0; i < count; ++i) {
+    const Vector3 &p = points[i].position;
+    int32_t x = floor_div((int32_t)floorf(p.x/level.cell), B);
+    int32_t y = floor_div((int32_t)floorf(p.y/level.cell), B);
+    int32_t z = floor_div((int32_t)floorf(p.z/level.cell), B);
+    // Consecutive points mostly share a block
+    uint64_t key = block_key(x, y, z);
+    if(key == last) {
+      continue;
+    }
+    last = key;
+    for(int n = 0; n < 27; ++n) {
+      add_block(level, x + n % 3 - 1, y + n / 3 % 3 - 1, z + n / 9 - 1);
+    }
+  }
+}
+
+/**
+ * @bref  Allocate the fine blocks under the coarse nodes next to a node on
+ *        the other side of the coarse surface, where the fine surface is
+ *        away from the points
+ * @param Fine blocks along each axis of a coarse cell
+ * @return None
+ */
+void PoissonReconstructor::add_crossings(int ratio) {
+  for(size_t b = 0; b < _coarse.blocks.size(); ++b) {
+    const Block &block = _coarse.blocks[b];
+    for(uint32_t v = 0; v < BLOCK_NODES; ++v) {
+      uint32_t node = b*BLOCK_NODES + v;
+      bool inside = _coarse.chi[node] < _coarse.iso;
+      bool crossed = false;
+      for(int n = 0; n < 27 && !crossed; ++n) {
+        uint32_t u = neighbour(_coarse, node, n % 3 - 1, n / 3 % 3 - 1, n / 9 - 1);
+        // Past the coarse level is outside
+        crossed = inside != (u != NONE && _coarse.chi[u] < _coarse.iso);
+      }
+      if(!crossed) {
+        continue;
+      }
+
+      int32_t x = (block.x*B + (int32_t)(v % B))*ratio;
+      int32_t y = (block.y*B + (int32_t)(v / B % B))*ratio;
+      int32_t z = (block.z*B + (int32_t)(v / (B*B)))*ratio;
+      for(int n = 0; n < ratio*ratio*ratio; ++n) {
+        add_block(_fine, x + n % ratio, y + n / ratio % ratio, z + n / (ratio*ratio));
+      }
+    }
+  }
+}
+
+/**
+ * @bref  Allocate a block unless it is already there
+ * @param Level
+ * @param Block coordinates
+ * @return true if the block is new
+ */
+bool PoissonReconstructor::add_block(Level &level, int32_t x, int32_t y, int32_t z) {
+  if(!level.block_indexes.emplace(block_key(x, y, z), (uint32_t)level.blocks.size()).second) {
+    return false;
+  }
+  level.blocks.push_back({x, y, z, {}});
+  return true;
+}
+
+void PoissonReconstructor::link_blocks(Level &level) {
+  for(Block &block : level.blocks) {
+    for(int n = 0; n < 27; ++n) {
+      auto found = level.block_indexes.find(block_key(block.x + n % 3 - 1, block.y + n / 3 % 3 - 1,
+        block.z + n / 9 - 1));
+      block.neighbours[n] = found == level.block_indexes.end() ? NONE : found->second;
+    }
+  }
+}
+
+/**
+ * @bref  Set up and solve the system of a level, and find its iso level
+ * @param Level, with its blocks
+ * @param Coarser level solved already to start from, or nullptr to start
+ *        from zero
+ * @param Points
+ * @param Normals
+ * @param How many
+ * @return true if the solver reached the tolerance
+ */
+bool PoissonReconstructor::solve_level(Level &level, const Level *coarse, const ScanPoint *points,
+  const Vector3 *normals, size_t count) {
+  build_system(level, points, normals, count);
+  if(coarse != nullptr) {
+    prolong(*coarse, level);
+  }
+  solve(level);
+  level.iso = iso_level(level, points, count);
+  return _residual < _tolerance;
+}
+
+/**
+ * @bref  Start a level from the trilinear interpolation of a coarser one,
+ *        shifted so its surface is at zero like the screening wants it.
+ *        Nodes past the coarser level take the value outside
+ * @param Coarser level
+ * @param Level to start
+ * @return None
+ */
+void PoissonReconstructor::prolong(const Level &coarse, Level &level) {
+  float scale = level.cell/coarse.cell;
+  _pool.parallel_for(level.chi.size(), [this, &coarse, &level, scale](size_t begin, size_t end, size_t) {
+    for(size_t v = begin; v < end; ++v) {
+      const Block &block = level.blocks[v/BLOCK_NODES];
+      uint32_t local = v % BLOCK_NODES;
+      // Nodes sit at the centers of the cells
+      float gx = (block.x*B + (int32_t)(local % B) + 0.5f)*scale - 0.5f;
+      float gy = (block.y*B + (int32_t)(local / B % B) + 0.5f)*scale - 0.5f;
+      float gz = (block.z*B + (int32_t)(local / (B*B)) + 0.5f)*scale - 0.5f;
+      int32_t x = (int32_t)floorf(gx), y = (int32_t)floorf(gy), z = (int32_t)floorf(gz);
+      float fx = gx - x, fy = gy - y, fz = gz - z;
+
+      float value = 0, weight = 0;
+      for(int c = 0; c < 8; ++c) {
+        uint32_t n = node_at(coarse, x + (c & 1), y + (c >> 1 & 1), z + (c >> 2 & 1));
+        if(n != NONE) {
+          float w = (c & 1 ? fx : 1 - fx)*(c & 2 ? fy : 1 - fy)*(c & 4 ? fz : 1 - fz);
+          value += w*(coarse.chi[n] - coarse.iso);
+          weight += w;
+        }
+      }
+      level.chi[v] = weight > 0 ? value/weight : SKIN_VALUE;
+    }
+  }, NODE_GRAIN);
+}
+
+/**
+ * @bref  Splat the normals and the screening of the points onto the nodes
+ *        and set up the right hand side, the divergence of the normal field
+ * @param Points
+ * @param Normals
+ * @param How many
+ * @return None
+ */
+void PoissonReconstructor::build_system(Level &level, const ScanPoint *points, const Vector3 *normals, size_t count) {
+  size_t nodes = level.blocks.size()*BLOCK_NODES;
+  level.chi.assign(nodes, 0);
+  level.rhs.assign(nodes, 0);
+  level.diagonal.assign(nodes, 0);
+  level.screening_rows.assign(nodes, NONE);
+  level.screening.clear();
+
+  std::vector<Vector3> field(nodes, Vector3{0, 0, 0});
+  std::vector<float> weights(nodes, 0);
+  double total_weight = 0;
+  for(size_t i = 0; i < count; ++i) {
+    float w = confidence(points[i]);
+    uint32_t n[8];
+    float phi[8];
+    corners(level, points[i].position, n, phi);
+    for(int c = 0; c < 8; ++c) {
+      field[n[c]] += normals[i]*(w*phi[c]);
+      weights[n[c]] += w*phi[c];
+    }
+    total_weight += w;
+  }
+
+  // The normal field, half a unit per edge over the two nodes around a
+  // point, makes the indicator step by about 1 across the surface
+  size_t splatted = 0;
+  for(size_t v = 0; v < nodes; ++v) {
+    if(weights[v] > 0) {
+      float length = field[v].norm();
+      field[v] = length > 0 ? field[v]*(0.5f/length) : field[v];
+      ++splatted;
+    }
+  }
+
+  // Screening scaled so alpha doesn't depend on the point density
+  float alpha = splatted > 0 && total_weight > 0 ? _alpha*splatted/total_weight : 0;
+  for(size_t i = 0; i < count; ++i) {
+    float w = alpha*confidence(points[i]);
+    uint32_t n[8];
+    float phi[8];
+    corners(level, points[i].position, n, phi);
+    for(int c = 0; c < 8; ++c) {
+      uint32_t &row = level.screening_rows[n[c]];
+      if(row == NONE) {
+        row = level.screening.size()/27;
+        level.screening.resize(level.screening.size() + 27, 0);
+      }
+      for(int d = 0; d < 8; ++d) {
+        int dx = (d & 1) - (c & 1), dy = (d >> 1 & 1) - (c >> 1 & 1), dz = (d >> 2 & 1) - (c >> 2 & 1);
+        level.screening[row*27 + slot(dx, dy, dz)] += w*phi[c]*phi[d];
+      }
+    }
+  }
+
+  // Each edge fits chi[j] - chi[i] to the mean of the field at its ends
+  _pool.parallel_for(nodes, [this, &level, &field](size_t begin, size_t end, size_t) {
+    for(size_t v = begin; v < end; ++v) {
+      float rhs = 0, degree = 0;
+      for(int a = 0; a < 3; ++a) {
+        int d[3] = {0, 0, 0};
+        d[a] = 1;
+        uint32_t up = neighbour(level, v, d[0], d[1], d[2]);
+        if(up != NONE) {
+          rhs -= 0.5f*((&field[v].x)[a] + (&field[up].x)[a]);
+          ++degree;
+        }
+        uint32_t down = neighbour(level, v, -d[0], -d[1], -d[2]);
+        if(down != NONE) {
+          rhs += 0.5f*((&field[v].x)[a] + (&field[down].x)[a]);
+          ++degree;
+        }
+      }
+      level.rhs[v] = rhs;
+      uint32_t row = level.screening_rows[v];
+      level.diagonal[v] = degree + (row != NONE ? level.screening[row*27 + slot(0, 0, 0)] : 0);
+    }
+  }, NODE_GRAIN);
+}
+
+/**
+ * @bref  Preconditioned conjugate gradients from the chi of the level
+ * @param Level, chi holding the start
+ * @return None
+ */
+void PoissonReconstructor::solve(Level &level) {
+  size_t nodes = level.chi.size();
+  std::vector<float> r(nodes), z(nodes), p(nodes), q(nodes);
+
+  multiply(level, level.chi, q);
+  _pool.parallel_for(nodes, [&level, &r, &q](size_t begin, size_t end, size_t) {
+    for(size_t v = begin; v < end; ++v) {
+      r[v] = level.rhs[v] - q[v];
+    }
+  }, NODE_GRAIN);
+
+  auto precondition = [&level, &r, &z](size_t begin, size_t end, size_t) {
+    for(size_t v = begin; v < end; ++v) {
+      z[v] = level.diagonal[v] > 0 ? r[v]/level.diagonal[v] : 0;
+    }
+  };
+  _pool.parallel_for(nodes, precondition, NODE_GRAIN);
+  p = z;
+
+  double rz = dot(r, z);
+  double norm = sqrt(dot(level.rhs, level.rhs));
+  _iterations = 0;
+  _residual = norm > 0 ? sqrt(dot(r, r))/norm : 1;
+  while(norm > 0 && _residual >= _tolerance && _iterations < _max_iterations) {
+    multiply(level, p, q);
+    double pq = dot(p, q);
+    if(!(pq > 0)) {
+      break;
+    }
+    float step = rz/pq;
+    _pool.parallel_for(nodes, [&level, &r, &p, &q, step](size_t begin, size_t end, size_t) {
+      for(size_t v = begin; v < end; ++v) {
+        level.chi[v] += step*p[v];
+        r[v] -= step*q[v];
+      }
+    }, NODE_GRAIN);
+    ++_iterations;
+
+    _residual = sqrt(dot(r, r))/norm;
+    if(_residual < _tolerance) {
+      break;
+    }
+
+    _pool.parallel_for(nodes, precondition, NODE_GRAIN);
+    double rz_next = dot(r, z);
+    float beta = rz_next/rz;
+    rz = rz_next;
+    _pool.parallel_for(nodes, [&p, &z, beta](size_t begin, size_t end, size_t) {
+      for(size_t v = begin; v < end; ++v) {
+        p[v] = z[v] + beta*p[v];
+      }
+    }, NODE_GRAIN);
+  }
+}
+
+/**
+ * @bref  Mean of the indicator at the points, weighted by their confidence,
+ *        where the surface is extracted
+ * @param Points
+ * @param How many
+ * @return Iso level
+ */
+float PoissonReconstructor::iso_level(Level &level, const ScanPoint *points, size_t count) {
+  double sum = 0, weight = 0;
+  for(size_t i = 0; i < count; ++i) {
+    uint32_t n[8];
+    float phi[8];
+    corners(level, points[i].position, n, phi);
+    double value = 0;
+    for(int c = 0; c < 8; ++c) {
+      value += phi[c]*level.chi[n[c]];
+    }
+    float w = confidence(points[i]);
+    sum += w*value;
+    weight += w;
+  }
+  return weight > 0 ? sum/weight : 0;
+}
+
+uint32_t PoissonReconstructor::node_at(const Level &level, int32_t x, int32_t y, int32_t z) {
+  auto found = level.block_indexes.find(block_key(floor_div(x, B), floor_div(y, B), floor_div(z, B)));
+  if(found == level.block_indexes.end()) {
+    return NONE;
+  }
+  int32_t m = B - 1;
+  return found->second*BLOCK_NODES + (x & m) + B*((y & m) + B*(z & m));
+}
+
+uint32_t PoissonReconstructor::neighbour(const Level &level, uint32_t node, int dx, int dy, int dz) {
+  uint32_t block = node/BLOCK_NODES, v = node%BLOCK_NODES;
+  int x = v % B + dx, y = v / B % B + dy, z = v / (B*B) + dz;
+  int bx = x < 0 ? -1 : (x >= B ? 1 : 0);
+  int by = y < 0 ? -1 : (y >= B ? 1 : 0);
+  int bz = z < 0 ? -1 : (z >= B ? 1 : 0);
+  if(bx != 0 || by != 0 || bz != 0) {
+    block = level.blocks[block].neighbours[slot(bx, by, bz)];
+    if(block == NONE) {
+      return NONE;
+    }
+  }
+  return block*BLOCK_NODES + (x - bx*B) + B*((y - by*B) + B*(z - bz*B));
+}
+
+float PoissonReconstructor::coarse_side(int32_t x, int32_t y, int32_t z, int ratio) {
+  // The coarse node of the cell the fine block is in
+  x = floor_div(x, ratio);
+  y = floor_div(y, ratio);
+  z = floor_div(z, ratio);
+  auto found = _coarse.block_indexes.find(block_key(floor_div(x, B), floor_div(y, B), floor_div(z, B)));
+  if(found == _coarse.block_indexes.end()) {
+    return 1;
+  }
+  int32_t m = B - 1;
+  uint32_t node = found->second*BLOCK_NODES + (x & m) + B*((y & m) + B*(z & m));
+  return _coarse.chi[node] < _coarse.iso ? -1 : 1;
+}
+
+float PoissonReconstructor::confidence(const ScanPoint &point) {
+  float w = point.signal_rate/_signal_reference;
+  return w > 1 ? 1 : (w > 0.05f ? w : 0.05f);
+}
+
+void PoissonReconstructor::corners(const Level &level, const Vector3 &p, uint32_t nodes[8], float weights[8]) {
+  // Nodes sit at the centers of the cells
+  float gx = p.x/level.cell - 0.5f, gy = p.y/level.cell - 0.5f, gz = p.z/level.cell - 0.5f;
+  int32_t x = (int32_t)floorf(gx), y = (int32_t)floorf(gy), z = (int32_t)floorf(gz);
+  float fx = gx - x, fy = gy - y, fz = gz - z;
+
+  // Within a block of the one holding the point, always allocated
+  uint32_t block = level.block_indexes.find(block_key(floor_div(x, B), floor_div(y, B), floor_div(z, B)))->second;
+  int32_t m = B - 1;
+  uint32_t base = block*BLOCK_NODES + (x & m) + B*((y & m) + B*(z & m));
+  for(int c = 0; c < 8; ++c) {
+    nodes[c] = neighbour(level, base, c & 1, c >> 1 & 1, c >> 2 & 1);
+    weights[c] = (c & 1 ? fx : 1 - fx)*(c & 2 ? fy : 1 - fy)*(c & 4 ? fz : 1 - fz);
+  }
+}
+
+/**
+ * @bref  Product of the system matrix, the graph Laplacian of the band plus
+ *        the screening, with a vector
+ * @param Vector
+ * @param Product out
+ * @return None
+ */
+void PoissonReconstructor::multiply(const Level &level, const std::vector<float> &x, std::vector<float> &y) {
+  _pool.parallel_for(x.size(), [this, &level, &x, &y](size_t begin, size_t end, size_t) {
+    for(size_t v = begin; v < end; ++v) {
+      uint32_t local = v % BLOCK_NODES;
+      int lx = local % B, ly = local / B % B, lz = local / (B*B);
+      // Away from the faces of its block all neighbours of a node are in it
+      bool inside = lx > 0 && lx < B - 1 && ly > 0 && ly < B - 1 && lz > 0 && lz < B - 1;
+
+      float sum;
+      if(inside) {
+        sum = 6*x[v] - x[v - 1] - x[v + 1] - x[v - B] - x[v + B] - x[v - B*B] - x[v + B*B];
+      } else {
+        float degree = 0;
+        sum = 0;
+        for(int a = 0; a < 3; ++a) {
+          for(int s = -1; s <= 1; s += 2) {
+            uint32_t n = neighbour(level, v, a == 0 ? s : 0, a == 1 ? s : 0, a == 2 ? s : 0);
+            if(n != NONE) {
+              sum -= x[n];
+              ++degree;
+            }
+          }
+        }
+        sum += degree*x[v];
+      }
+
+      uint32_t row = level.screening_rows[v];
+      if(row != NONE) {
+        const float *coefficients = &level.screening[row*27];
+        for(int n = 0; n < 27; ++n) {
+          if(coefficients[n] != 0) {
+            int dx = n % 3 - 1, dy = n / 3 % 3 - 1, dz = n / 9 - 1;
+            uint32_t u = inside ? v + dx + B*(dy + B*dz) : neighbour(level, v, dx, dy, dz);
+            sum += coefficients[n]*x[u];
+          }
+        }
+      }
+      y[v] = sum;
+    }
+  }, NODE_GRAIN);
+}
+
+double PoissonReconstructor::dot(const std::vector<float> &a, const std::vector<float> &b) {
+  std::vector<double> sums(_pool.size(), 0);
+  _pool.parallel_for(a.size(), [&a, &b, &sums](size_t begin, size_t end, size_t thread) {
+    double sum = 0;
+    for(size_t v = begin; v < end; ++v) {
+      sum += (double)a[v]*b[v];
+    }
+    sums[thread] += sum;
+  }, NODE_GRAIN);
+
+  double sum = 0;
+  for(double s : sums) {
+    sum += s;
+  }
+  return sum;
+}
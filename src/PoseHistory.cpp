@@ -0,0 +1,283 @@
+#include <cmath>
+
+#include "PoseHistory.hpp"
+
+#define POSE_HISTORY_MASK (POSE_HISTORY_CAPACITY - 1)
+
+// Above this cosine the quaternions are so close that spherical
+// interpolation would divide by almost zero, linear weights are exact enough
+#define SLERP_MIN_ANGLE_COSINE 0.9995f
+
+/**
+ * @bref  Weights of the two quaternions, q = w0*q0 + w1*q1 before normalizing
+ * @param Cosine of the angle between the quaternions, made positive
+ * @param Interpolation fraction from q0 to q1
+ * @param Spherical or linear interpolation
+ * @param Weight of q0
+ * @param Weight of q1
+ * @return None
+ */
+static inline void interpolation_weights(float cosine, float alpha, bool slerp, float &w0, float &w1) {
+  if(slerp && cosine < SLERP_MIN_ANGLE_COSINE) {
+    float angle = std::acos(cosine);
+    float inv_sin = 1/std::sin(angle);
+    w0 = std::sin((1 - alpha)*angle)*inv_sin;
+    w1 = std::sin(alpha*angle)*inv_sin;
+  } else {
+    w0 = 1 - alpha;
+    w1 = alpha;
+  }
+}
+
+PoseHistory::PoseHistory() {
+  clear();
+}
+
+/**
+ * @bref  Publish a new pose, overwriting the oldest one when full
+ * @param Pose, newer than the previous one
+ * @return true if added or false if out of order
+ */
+bool PoseHistory::append(const Pose &pose) {
+  uint64_t head = _head.load(std::memory_order_relaxed);
+  if(head > 0 && _slots[(head - 1) & POSE_HISTORY_MASK].pose.timestamp >= pose.timestamp) {
+    return false;
+  }
+
+  // Readers of the slot being overwritten see the odd sequence, or a
+  // different one once they're done copying, and drop what they copied
+  Slot &slot = _slots[head & POSE_HISTORY_MASK];
+  slot.sequence.store(2*head + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.pose = pose;
+  slot.sequence.store(2*head + 2, std::memory_order_release);
+
+  _head.store(head + 1, std::memory_order_release);
+  return true;
+}
+
+/**
+ * @bref  Pose at one time
+ * @param Time in microseconds
+ * @param Interpolated pose
+ * @param Spherical or normalized linear interpolation
+ * @return true if success or false if the time is out of the history
+ */
+bool PoseHistory::interpolate(uint64_t t, Pose &pose, bool slerp) {
+  uint64_t hint = UINT64_MAX;
+  Pose before, after;
+  if(!bracket(t, hint, before, after)) {
+    return false;
+  }
+
+  uint64_t span = after.timestamp - before.timestamp;
+  float alpha = span > 0 ? (float)(t - before.timestamp)/span : 0;
+
+  const Quaternion &q0 = before.orientation;
+  Quaternion q1 = after.orientation;
+  float cosine = q0.dot(q1);
+  if(cosine < 0) {
+    // q and -q are the same rotation, take the short way
+    q1 = {-q1.w, -q1.x, -q1.y, -q1.z};
+    cosine = -cosine;
+  }
+
+  float w0, w1;
+  interpolation_weights(cosine, alpha, slerp, w0, w1);
+
+  pose.timestamp = t;
+  pose.orientation = Quaternion{
+    w0*q0.w + w1*q1.w, w0*q0.x + w1*q1.x, w0*q0.y + w1*q1.y, w0*q0.z + w1*q1.z
+  }.normalized();
+  pose.position = before.position*(1 - alpha) + after.position*alpha;
+  return true;
+}
+
+/**
+ * @bref  Poses at many times, looked up one chunk at a time and then
+ *        interpolated with the chunk laid out as arrays of each component so
+ *        the arithmetic runs over contiguous data
+ * @param Times in microseconds
+ * @param How many times
+ * @param Interpolated poses, timestamp 0 for times out of the history
+ * @param Spherical or normalized linear interpolation
+ * @return How many poses were interpolated
+ */
+size_t PoseHistory::interpolate(const uint64_t *times, size_t count, Pose *poses, bool slerp) {
+  float qw0[POSE_HISTORY_BATCH], qx0[POSE_HISTORY_BATCH], qy0[POSE_HISTORY_BATCH], qz0[POSE_HISTORY_BATCH];
+  float qw1[POSE_HISTORY_BATCH], qx1[POSE_HISTORY_BATCH], qy1[POSE_HISTORY_BATCH], qz1[POSE_HISTORY_BATCH];
+  float alpha[POSE_HISTORY_BATCH], w0[POSE_HISTORY_BATCH], w1[POSE_HISTORY_BATCH];
+  Vector3 p0[POSE_HISTORY_BATCH], p1[POSE_HISTORY_BATCH];
+  bool valid[POSE_HISTORY_BATCH];
+
+  size_t interpolated = 0;
+  uint64_t hint = UINT64_MAX;
+
+  for(size_t start = 0; start < count; start += POSE_HISTORY_BATCH) {
+    size_t n = count - start < POSE_HISTORY_BATCH ? count - start : POSE_HISTORY_BATCH;
+
+    for(size_t i = 0; i < n; ++i) {
+      uint64_t t = times[start + i];
+      Pose before, after;
+      valid[i] = bracket(t, hint, before, after);
+      if(!valid[i]) {
+        // Harmless values, the result is discarded
+        before.timestamp = after.timestamp = t;
+        before.orientation = after.orientation = Quaternion::identity();
+        before.position = after.position = {0, 0, 0};
+      }
+
+      uint64_t span = after.timestamp - before.timestamp;
+      alpha[i] = span > 0 ? (float)(t - before.timestamp)/span : 0;
+      qw0[i] = before.orientation.w; qx0[i] = before.orientation.x;
+      qy0[i] = before.orientation.y; qz0[i] = before.orientation.z;
+      qw1[i] = after.orientation.w; qx1[i] = after.orientation.x;
+      qy1[i] = after.orientation.y; qz1[i] = after.orientation.z;
+      p0[i] = before.position;
+      p1[i] = after.position;
+    }
+
+    for(size_t i = 0; i < n; ++i) {
+      float cosine = qw0[i]*qw1[i] + qx0[i]*qx1[i] + qy0[i]*qy1[i] + qz0[i]*qz1[i];
+      float sign = cosine < 0 ? -1.0f : 1.0f;
+      interpolation_weights(cosine*sign, alpha[i], slerp, w0[i], w1[i]);
+      w1[i] *= sign;
+    }
+
+    for(size_t i = 0; i < n; ++i) {
+      float w = w0[i]*qw0[i] + w1[i]*qw1[i];
+      float x = w0[i]*qx0[i] + w1[i]*qx1[i];
+      float y = w0[i]*qy0[i] + w1[i]*qy1[i];
+      float z = w0[i]*qz0[i] + w1[i]*qz1[i];
+      float inv_norm = 1/std::sqrt(w*w + x*x + y*y + z*z);
+      float a = alpha[i];
+
+      Pose &pose = poses[start + i];
+      pose.timestamp = valid[i] ? times[start + i] : 0;
+      pose.orientation = {w*inv_norm, x*inv_norm, y*inv_norm, z*inv_norm};
+      pose.position = p0[i]*(1 - a) + p1[i]*a;
+      interpolated += valid[i];
+    }
+  }
+
+  return interpolated;
+}
+
+/**
+ * @bref  Time span held by the history
+ * @param Timestamp of the oldest pose
+ * @param Timestamp of the newest pose
+ * @return true if there are at least two poses or false if don't
+ */
+bool PoseHistory::get_range(uint64_t &oldest, uint64_t &newest) {
+  uint64_t head = _head.load(std::memory_order_acquire);
+  if(head < 2) {
+    return false;
+  }
+
+  Pose first, last;
+  uint64_t index = head > POSE_HISTORY_CAPACITY ? head - POSE_HISTORY_CAPACITY : 0;
+  while(!read(index, first)) {
+    if(++index >= head - 1) {
+      return false;
+    }
+  }
+  if(!read(head - 1, last)) {
+    return false;
+  }
+
+  oldest = first.timestamp;
+  newest = last.timestamp;
+  return true;
+}
+
+size_t PoseHistory::size(void) {
+  uint64_t head = _head.load(std::memory_order_acquire);
+  return head > POSE_HISTORY_CAPACITY ? POSE_HISTORY_CAPACITY : head;
+}
+
+/**
+ * @bref  Drop all poses, only while no reader is running
+ * @param None
+ * @return None
+ */
+void PoseHistory::clear(void) {
+  for(size_t i = 0; i < POSE_HISTORY_CAPACITY; ++i) {
+    _slots[i].sequence.store(0, std::memory_order_relaxed);
+    _slots[i].pose.timestamp = 0;
+  }
+  _head.store(0, std::memory_order_release);
+}
+
+bool PoseHistory::read(uint64_t index, Pose &pose) {
+  const Slot &slot = _slots[index & POSE_HISTORY_MASK];
+  uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+  if(sequence != 2*index + 2) {
+    return false;
+  }
+  pose = slot.pose;
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return slot.sequence.load(std::memory_order_relaxed) == sequence;
+}
+
+bool PoseHistory::bracket(uint64_t t, uint64_t &hint, Pose &before, Pose &after) {
+  uint64_t head = _head.load(std::memory_order_acquire);
+  if(head < 2) {
+    return false;
+  }
+  uint64_t newest = head - 1;
+  uint64_t oldest = head > POSE_HISTORY_CAPACITY ? head - POSE_HISTORY_CAPACITY : 0;
+
+  // The oldest slots may be overwritten while we look, move past them
+  Pose first, last;
+  while(!read(oldest, first)) {
+    if(++oldest >= newest) {
+      return false;
+    }
+  }
+  if(!read(newest, last) || t < first.timestamp || t > last.timestamp) {
+    return false;
+  }
+
+  // The hint is only worth walking from when t is a step or two away from
+  // it, as for consecutive ranges, otherwise guess from the mean period
+  double period = (double)(last.timestamp - first.timestamp)/(newest - oldest);
+  uint64_t index = hint;
+  if(index < oldest || index >= newest || !read(index, before) ||
+    fabs((double)t - (double)before.timestamp) > 2*period) {
+    double fraction = last.timestamp > first.timestamp ?
+      (double)(t - first.timestamp)/(last.timestamp - first.timestamp) : 0;
+    index = oldest + (uint64_t)(fraction*(newest - oldest));
+    if(index >= newest) {
+      index = newest - 1;
+    }
+  }
+
+  while(true) {
+    if(!read(index, before)) {
+      // Overwritten under us, only possible at the old end
+      if(++index >= newest) {
+        return false;
+      }
+      continue;
+    }
+    if(before.timestamp > t) {
+      if(index == oldest) {
+        return false;
+      }
+      --index;
+      continue;
+    }
+    if(!read(index + 1, after)) {
+      return false;
+    }
+    if(after.timestamp < t) {
+      ++index;
+      continue;
+    }
+    break;
+  }
+
+  hint = index;
+  return true;
+}
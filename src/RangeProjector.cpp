@@ -0,0 +1,181 @@
+#include <string.h>
+
+#include "RangeProjector.hpp"
+
+// Four floats, mapped by the compiler onto NEON or SSE registers
+typedef float float4 __attribute__((vector_size(16)));
+
+static inline float4 load4(const float *p) {
+  float4 v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline void store4(float *p, float4 v) {
+  memcpy(p, &v, sizeof(v));
+}
+
+RangeProjector::RangeProjector(PoseHistory &poses) : _poses(poses) {
+  for(size_t i = 0; i < RANGE_PROJECTOR_MAX_SENSORS; ++i) {
+    _origins[i] = {0, 0, 0};
+    _directions[i] = {0, 0, 1};
+  }
+  _missing_poses = 0;
+  // Both hold at most RANGE_PROJECTOR_MAX_PENDING ranges and swap their
+  // storage, so projecting never allocates
+  _pending.reserve(RANGE_PROJECTOR_MAX_PENDING);
+  _retry.reserve(RANGE_PROJECTOR_MAX_PENDING);
+}
+
+/**
+ * @bref  Set where a ranging sensor sits on the scanner
+ * @param Sensor index
+ * @param Position of the sensor in the body frame, meters
+ * @param Rotation from the sensor frame to the body frame
+ * @return true if success or false if the index is out of range
+ */
+bool RangeProjector::set_extrinsic(uint8_t sensor, const Vector3 &origin, const Quaternion &rotation) {
+  if(sensor >= RANGE_PROJECTOR_MAX_SENSORS) {
+    return false;
+  }
+  _origins[sensor] = origin;
+  _directions[sensor] = rotation.normalized().rotate({0, 0, 1});
+  return true;
+}
+
+/**
+ * @bref  Project the pending ranges, then the valid ranges of a sequence
+ *        of events
+ * @param Events, IMU samples among them are ignored
+ * @param How many events
+ * @param Points out
+ * @return How many points were written
+ */
+size_t RangeProjector::project(const SensorEvent *events, size_t count, ScanPoint *points) {
+  const SensorEvent *batch[RANGE_PROJECTOR_BATCH];
+  size_t batch_size = 0, projected = 0;
+
+  // The ranges still pending go first, in time order, and those whose pose
+  // hasn't come yet again go back into _pending
+  _retry.swap(_pending);
+  size_t total = _retry.size() + count;
+
+  for(size_t i = 0; i < total; ++i) {
+    const SensorEvent &event = i < _retry.size() ? _retry[i] : events[i - _retry.size()];
+    if(event.type != EVENT_RANGE || event.range.rangeStatus != RangeValid ||
+      event.sensor >= RANGE_PROJECTOR_MAX_SENSORS) {
+      continue;
+    }
+    batch[batch_size++] = &event;
+    if(batch_size == RANGE_PROJECTOR_BATCH) {
+      projected += project_batch(batch, batch_size, points + projected);
+      batch_size = 0;
+    }
+  }
+  if(batch_size > 0) {
+    projected += project_batch(batch, batch_size, points + projected);
+  }
+  _retry.clear();
+
+  return projected;
+}
+
+size_t RangeProjector::get_pending(void) {
+  return _pending.size();
+}
+
+uint64_t RangeProjector::get_missing_poses(void) {
+  return _missing_poses;
+}
+
+/**
+ * @bref  Interpolate the poses of a batch and transform its ranges
+ * @param Valid range events
+ * @param How many, at most RANGE_PROJECTOR_BATCH
+ * @param Points out
+ * @return How many points were written
+ */
+size_t RangeProjector::project_batch(const SensorEvent *const *ranges, size_t count, ScanPoint *points) {
+  uint64_t times[RANGE_PROJECTOR_BATCH] = {0};
+  Pose poses[RANGE_PROJECTOR_BATCH];
+  for(size_t i = 0; i < count; ++i) {
+    times[i] = ranges[i]->timestamp;
+  }
+  // The span is read before interpolating, a pose published in between
+  // only moves the history past it, so a range after newest that finds no
+  // pose is still waiting for one
+  uint64_t oldest = 0, newest = 0;
+  if(!_poses.get_range(oldest, newest)) {
+    // The estimator hasn't started, every range waits
+    oldest = newest = 0;
+  }
+  // Poses are a few milliseconds apart, linear interpolation is enough
+  _poses.interpolate(times, count, poses, false);
+
+  // Components as arrays, the tail up to a multiple of four padded with zeros
+  alignas(16) float qw[RANGE_PROJECTOR_BATCH] = {0}, qx[RANGE_PROJECTOR_BATCH] = {0};
+  alignas(16) float qy[RANGE_PROJECTOR_BATCH] = {0}, qz[RANGE_PROJECTOR_BATCH] = {0};
+  alignas(16) float px[RANGE_PROJECTOR_BATCH] = {0}, py[RANGE_PROJECTOR_BATCH] = {0}, pz[RANGE_PROJECTOR_BATCH] = {0};
+  alignas(16) float ox[RANGE_PROJECTOR_BATCH] = {0}, oy[RANGE_PROJECTOR_BATCH] = {0}, oz[RANGE_PROJECTOR_BATCH] = {0};
+  alignas(16) float dx[RANGE_PROJECTOR_BATCH] = {0}, dy[RANGE_PROJECTOR_BATCH] = {0}, dz[RANGE_PROJECTOR_BATCH] = {0};
+  alignas(16) float r[RANGE_PROJECTOR_BATCH] = {0};
+  for(size_t i = 0; i < count; ++i) {
+    const Pose &pose = poses[i];
+    qw[i] = pose.orientation.w; qx[i] = pose.orientation.x;
+    qy[i] = pose.orientation.y; qz[i] = pose.orientation.z;
+    px[i] = pose.position.x; py[i] = pose.position.y; pz[i] = pose.position.z;
+
+    uint8_t sensor = ranges[i]->sensor;
+    ox[i] = _origins[sensor].x; oy[i] = _origins[sensor].y; oz[i] = _origins[sensor].z;
+    dx[i] = _directions[sensor].x; dy[i] = _directions[sensor].y; dz[i] = _directions[sensor].z;
+    r[i] = ranges[i]->range.rangeMillimeters*0.001f;
+  }
+
+  // Results overwrite the inputs they no longer need: the point goes into
+  // d, the ray origin into o
+  for(size_t i = 0; i < count; i += 4) {
+    float4 w = load4(qw + i), x = load4(qx + i), y = load4(qy + i), z = load4(qz + i);
+
+    // Rotation matrix of the pose
+    float4 xx = x*x, yy = y*y, zz = z*z;
+    float4 xy = x*y, xz = x*z, yz = y*z;
+    float4 wx = w*x, wy = w*y, wz = w*z;
+    float4 r00 = 1.0f - 2.0f*(yy + zz), r01 = 2.0f*(xy - wz), r02 = 2.0f*(xz + wy);
+    float4 r10 = 2.0f*(xy + wz), r11 = 1.0f - 2.0f*(xx + zz), r12 = 2.0f*(yz - wx);
+    float4 r20 = 2.0f*(xz - wy), r21 = 2.0f*(yz + wx), r22 = 1.0f - 2.0f*(xx + yy);
+
+    float4 o_x = load4(ox + i), o_y = load4(oy + i), o_z = load4(oz + i);
+    float4 range = load4(r + i);
+    float4 b_x = o_x + load4(dx + i)*range;
+    float4 b_y = o_y + load4(dy + i)*range;
+    float4 b_z = o_z + load4(dz + i)*range;
+
+    float4 p_x = load4(px + i), p_y = load4(py + i), p_z = load4(pz + i);
+    store4(dx + i, r00*b_x + r01*b_y + r02*b_z + p_x);
+    store4(dy + i, r10*b_x + r11*b_y + r12*b_z + p_y);
+    store4(dz + i, r20*b_x + r21*b_y + r22*b_z + p_z);
+    store4(ox + i, r00*o_x + r01*o_y + r02*o_z + p_x);
+    store4(oy + i, r10*o_x + r11*o_y + r12*o_z + p_y);
+    store4(oz + i, r20*o_x + r21*o_y + r22*o_z + p_z);
+  }
+
+  size_t written = 0;
+  for(size_t i = 0; i < count; ++i) {
+    if(poses[i].timestamp == 0) {
+      if(times[i] > newest && _pending.size() < RANGE_PROJECTOR_MAX_PENDING) {
+        _pending.push_back(*ranges[i]);
+      } else {
+        ++_missing_poses;
+      }
+      continue;
+    }
+    ScanPoint &point = points[written++];
+    point.position = {dx[i], dy[i], dz[i]};
+    point.origin = {ox[i], oy[i], oz[i]};
+    point.signal_rate = ranges[i]->range.signalRateMCPS;
+    point.sensor = ranges[i]->sensor;
+    point.timestamp = times[i];
+  }
+
+  return written;
+}
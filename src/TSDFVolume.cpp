@@ -0,0 +1,339 @@
+#include <cmath>
+#include <string.h>
+
+#include "TSDFVolume.hpp"
+
+// Bits per block coordinate in a key
+#define KEY_BITS 21
+#define KEY_OFFSET (1 << (KEY_BITS - 1))
+#define KEY_MASK ((1ULL << KEY_BITS) - 1)
+
+#define EMPTY_KEY UINT64_MAX
+#define NO_BLOCK UINT32_MAX
+
+// Initial size of the block hash, a power of two
+#define INITIAL_SLOTS 4096
+
+// Rays traced at a time by a thread
+#define TRACE_GRAIN 64
+
+static inline int32_t floor_div(int32_t a, int32_t b) {
+  return a >= 0 ? a/b : -((-a + b - 1)/b);
+}
+
+// Blocks of a shard are spread over the volume
+static inline size_t shard_of(uint64_t key) {
+  return (key*0x9e3779b97f4a7c15ULL >> 40) % TSDF_SHARDS;
+}
+
+static inline uint64_t block_key(int32_t x, int32_t y, int32_t z) {
+  return ((uint64_t)(x + KEY_OFFSET) & KEY_MASK) << (2*KEY_BITS) |
+    ((uint64_t)(y + KEY_OFFSET) & KEY_MASK) << KEY_BITS | ((uint64_t)(z + KEY_OFFSET) & KEY_MASK);
+}
+
+TSDFVolume::TSDFVolume(ThreadPool &pool, float voxel_size, float truncation) : _pool(pool) {
+  _voxel_size = voxel_size;
+  _truncation = truncation;
+  _signal_reference = 2.0f;
+  _max_weight = 100.0f;
+  _range_noise = 0.05f;
+  _pass = 0;
+  _keys.assign(INITIAL_SLOTS, EMPTY_KEY);
+  _slots.assign(INITIAL_SLOTS, NO_BLOCK);
+  _mask = INITIAL_SLOTS - 1;
+}
+
+bool TSDFVolume::set_signal_reference(float signal_rate) {
+  if(!(signal_rate > 0)) {
+    return false;
+  }
+  _signal_reference = signal_rate;
+  return true;
+}
+
+bool TSDFVolume::set_max_weight(float max_weight) {
+  if(!(max_weight > 0)) {
+    return false;
+  }
+  _max_weight = max_weight;
+  return true;
+}
+
+bool TSDFVolume::set_range_noise(float relative) {
+  if(relative < 0) {
+    return false;
+  }
+  _range_noise = relative;
+  return true;
+}
+
+/**
+ * @bref  Fuse a batch of ranges
+ * @param Points, each with the origin of its ray
+ * @param How many points
+ * @return None
+ */
+void TSDFVolume::integrate(const ScanPoint *points, size_t count) {
+  ++_pass;
+  size_t chunks = (count + TRACE_GRAIN - 1)/TRACE_GRAIN;
+  if(_chunks.size() < chunks) {
+    _chunks.resize(chunks);
+  }
+  _scratch.resize(_pool.size());
+
+  // Ranges are handed out TRACE_GRAIN rays at a time, each fills its chunk
+  _pool.parallel_for(count, [this, points](size_t begin, size_t end, size_t thread) {
+    std::vector<Update> &scratch = _scratch[thread];
+    scratch.clear();
+    for(size_t i = begin; i < end; ++i) {
+      trace(points[i], scratch);
+    }
+
+    // Counting sort by shard, keeping the order of the rays within each
+    Chunk &chunk = _chunks[begin/TRACE_GRAIN];
+    uint32_t *offsets = chunk.offsets;
+    for(size_t shard = 0; shard <= TSDF_SHARDS; ++shard) {
+      offsets[shard] = 0;
+    }
+    for(const Update &update : scratch) {
+      ++offsets[shard_of(update.key) + 1];
+    }
+    for(size_t shard = 0; shard < TSDF_SHARDS; ++shard) {
+      offsets[shard + 1] += offsets[shard];
+    }
+    chunk.updates.resize(scratch.size());
+    uint32_t next[TSDF_SHARDS];
+    memcpy(next, offsets, sizeof(next));
+    for(const Update &update : scratch) {
+      chunk.updates[next[shard_of(update.key)]++] = update;
+    }
+  }, TRACE_GRAIN);
+
+  // The hash isn't shared while growing, consecutive updates of a shard
+  // mostly fall in the same block
+  for(size_t c = 0; c < chunks; ++c) {
+    uint64_t last = EMPTY_KEY;
+    uint32_t block = NO_BLOCK;
+    for(Update &update : _chunks[c].updates) {
+      if(update.key != last) {
+        last = update.key;
+        block = find(last);
+        if(block == NO_BLOCK) {
+          block = allocate(last);
+        }
+      }
+      update.block = block;
+    }
+  }
+
+  _pool.parallel_for(TSDF_SHARDS, [this, chunks](size_t begin, size_t end, size_t) {
+    for(size_t shard = begin; shard < end; ++shard) {
+      for(size_t c = 0; c < chunks; ++c) {
+        const Chunk &chunk = _chunks[c];
+        for(uint32_t u = chunk.offsets[shard]; u < chunk.offsets[shard + 1]; ++u) {
+          const Update &update = chunk.updates[u];
+          TSDFBlock &block = _blocks[update.block];
+          TSDFVoxel &voxel = block.voxels[update.voxel];
+          float weight = voxel.weight + update.weight;
+          voxel.sdf = (voxel.sdf*voxel.weight + update.sdf*update.weight)/weight;
+          voxel.weight = weight < _max_weight ? weight : _max_weight;
+          block.updated = _pass;
+        }
+      }
+    }
+  });
+}
+
+/**
+ * @bref  Replace the voxels of a block
+ * @param Block coordinates
+ * @param TSDF_BLOCK_VOXELS voxels
+ * @return None
+ */
+void TSDFVolume::set_block(int32_t x, int32_t y, int32_t z, const TSDFVoxel *voxels) {
+  uint64_t key = block_key(x, y, z);
+  uint32_t index = find(key);
+  ++_pass;
+  if(index == NO_BLOCK) {
+    index = allocate(key);
+  }
+  TSDFBlock &block = _blocks[index];
+  memcpy(block.voxels, voxels, sizeof(block.voxels));
+  block.updated = _pass;
+}
+
+void TSDFVolume::clear(void) {
+  _blocks.clear();
+  _keys.assign(_keys.size(), EMPTY_KEY);
+}
+
+/**
+ * @bref  Look up the voxel containing a point
+ * @param Point
+ * @param Voxel out
+ * @return true if its block is allocated or false if don't
+ */
+bool TSDFVolume::get_voxel(const Vector3 &p, TSDFVoxel &voxel) {
+  int32_t x = (int32_t)floorf(p.x/_voxel_size);
+  int32_t y = (int32_t)floorf(p.y/_voxel_size);
+  int32_t z = (int32_t)floorf(p.z/_voxel_size);
+  const TSDFBlock *block = find_block(floor_div(x, TSDF_BLOCK_SIZE), floor_div(y, TSDF_BLOCK_SIZE),
+    floor_div(z, TSDF_BLOCK_SIZE));
+  if(block == nullptr) {
+    return false;
+  }
+  int32_t m = TSDF_BLOCK_SIZE - 1;
+  voxel = block->voxels[(x & m) + TSDF_BLOCK_SIZE*((y & m) + TSDF_BLOCK_SIZE*(z & m))];
+  return true;
+}
+
+const TSDFBlock *TSDFVolume::find_block(int32_t x, int32_t y, int32_t z) {
+  uint32_t block = find(block_key(x, y, z));
+  return block == NO_BLOCK ? nullptr : &_blocks[block];
+}
+
+size_t TSDFVolume::get_block_count(void) {
+  return _blocks.size();
+}
+
+const TSDFBlock &TSDFVolume::get_block(size_t block) {
+  return _blocks[block];
+}
+
+float TSDFVolume::get_voxel_size(void) {
+  return _voxel_size;
+}
+
+uint32_t TSDFVolume::get_pass(void) {
+  return _pass;
+}
+
+/**
+ * @bref  Walk the voxels a ray crosses within the band around its end
+ *        (Amanatides and Woo), recording their updates
+ * @param Point and origin of the ray
+ * @param Updates out
+ * @return None
+ */
+void TSDFVolume::trace(const ScanPoint &point, std::vector<Update> &updates) {
+  Vector3 o = point.origin;
+  Vector3 d = point.position - o;
+  float range = d.norm();
+  float strength = point.signal_rate/_signal_reference;
+  if(!(range > 0) || !(strength > 0)) {
+    return;
+  }
+  d = d*(1.0f/range);
+  if(strength > 1) {
+    strength = 1;
+  }
+
+  float band = _range_noise*range > _truncation ? _range_noise*range : _truncation;
+  float t = range > band ? range - band : 0;
+  float t_end = range + band;
+
+  const float *dir = &d.x;
+  const float *org = &o.x;
+  int32_t voxel[3], step[3];
+  float t_max[3], t_delta[3];
+  for(int a = 0; a < 3; ++a) {
+    voxel[a] = (int32_t)floorf((org[a] + dir[a]*t)/_voxel_size);
+    step[a] = dir[a] >= 0 ? 1 : -1;
+    if(dir[a] != 0) {
+      float boundary = (voxel[a] + (step[a] > 0 ? 1 : 0))*_voxel_size;
+      t_max[a] = (boundary - org[a])/dir[a];
+      t_delta[a] = _voxel_size/fabsf(dir[a]);
+    } else {
+      t_max[a] = INFINITY;
+      t_delta[a] = INFINITY;
+    }
+  }
+
+  int32_t m = TSDF_BLOCK_SIZE - 1;
+  // Bounds the walk if rounding keeps t from reaching t_end
+  int steps = 3*(int)(2*band/_voxel_size) + 6;
+  while(t <= t_end && steps-- > 0) {
+    Vector3 center = {(voxel[0] + 0.5f)*_voxel_size, (voxel[1] + 0.5f)*_voxel_size,
+      (voxel[2] + 0.5f)*_voxel_size};
+    float sdf = range - (center - o).dot(d);
+    if(sdf > -band) {
+      if(sdf > band) {
+        sdf = band;
+      }
+      // Behind the surface the ray may as well have hit something else
+      float weight = sdf < 0 ? strength*(1 + sdf/band) : strength;
+      updates.push_back({block_key(floor_div(voxel[0], TSDF_BLOCK_SIZE), floor_div(voxel[1], TSDF_BLOCK_SIZE),
+        floor_div(voxel[2], TSDF_BLOCK_SIZE)), NO_BLOCK,
+        (uint16_t)((voxel[0] & m) + TSDF_BLOCK_SIZE*((voxel[1] & m) + TSDF_BLOCK_SIZE*(voxel[2] & m))),
+        sdf, weight});
+    }
+
+    int a = t_max[0] < t_max[1] ? (t_max[0] < t_max[2] ? 0 : 2) : (t_max[1] < t_max[2] ? 1 : 2);
+    t = t_max[a];
+    t_max[a] += t_delta[a];
+    voxel[a] += step[a];
+  }
+}
+
+uint32_t TSDFVolume::find(uint64_t key) {
+  size_t s = (key*0x9e3779b97f4a7c15ULL) >> 32 & _mask;
+  while(_keys[s] != EMPTY_KEY) {
+    if(_keys[s] == key) {
+      return _slots[s];
+    }
+    s = (s + 1) & _mask;
+  }
+  return NO_BLOCK;
+}
+
+/**
+ * @bref  Add a cleared block, the key must not be in the hash yet
+ * @param Block key
+ * @return Index of the block
+ */
+uint32_t TSDFVolume::allocate(uint64_t key) {
+  if(2*(_blocks.size() + 1) > _keys.size()) {
+    grow();
+  }
+
+  size_t s = (key*0x9e3779b97f4a7c15ULL) >> 32 & _mask;
+  while(_keys[s] != EMPTY_KEY) {
+    s = (s + 1) & _mask;
+  }
+  _keys[s] = key;
+  _slots[s] = _blocks.size();
+
+  _blocks.emplace_back();
+  TSDFBlock &block = _blocks.back();
+  block.x = (int32_t)(key >> (2*KEY_BITS) & KEY_MASK) - KEY_OFFSET;
+  block.y = (int32_t)(key >> KEY_BITS & KEY_MASK) - KEY_OFFSET;
+  block.z = (int32_t)(key & KEY_MASK) - KEY_OFFSET;
+  block.updated = _pass;
+  for(TSDFVoxel &voxel : block.voxels) {
+    voxel = {0, 0};
+  }
+
+  return _blocks.size() - 1;
+}
+
+void TSDFVolume::grow(void) {
+  std::vector<uint64_t> keys(2*_keys.size(), EMPTY_KEY);
+  std::vector<uint32_t> slots(2*_slots.size(), NO_BLOCK);
+  size_t mask = keys.size() - 1;
+
+  for(size_t i = 0; i < _keys.size(); ++i) {
+    if(_keys[i] == EMPTY_KEY) {
+      continue;
+    }
+    size_t s = (_keys[i]*0x9e3779b97f4a7c15ULL) >> 32 & mask;
+    while(keys[s] != EMPTY_KEY) {
+      s = (s + 1) & mask;
+    }
+    keys[s] = _keys[i];
+    slots[s] = _slots[i];
+  }
+
+  _keys.swap(keys);
+  _slots.swap(slots);
+  _mask = mask;
+}
@@ -0,0 +1,108 @@
+#include "ThreadPool.hpp"
+
+ThreadPool::ThreadPool(size_t threads) {
+  if(threads == 0) {
+    threads = std::thread::hardware_concurrency();
+  }
+  if(threads == 0) {
+    threads = 1;
+  }
+
+  _stopping = false;
+  _generation = 0;
+  _running = 0;
+  _body = nullptr;
+  _count = 0;
+  _grain = 1;
+  _next = 0;
+  for(size_t i = 1; i < threads; ++i) {
+    _threads.emplace_back(&ThreadPool::run, this, i);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  std::unique_lock<std::mutex> lock(_mutex);
+  _stopping = true;
+  lock.unlock();
+  _start.notify_all();
+  for(std::thread &thread : _threads) {
+    thread.join();
+  }
+}
+
+size_t ThreadPool::size(void) {
+  return _threads.size() + 1;
+}
+
+/**
+ * @bref  Run a loop on every thread and wait for it to complete
+ * @param Number of indexes
+ * @param Loop body, called with a range of indexes and the thread number
+ * @param Indexes taken at a time
+ * @return None
+ */
+void ThreadPool::parallel_for(size_t count, const std::function<void(size_t, size_t, size_t)> &body,
+  size_t grain) {
+  if(count == 0) {
+    return;
+  }
+  if(grain == 0) {
+    grain = 1;
+  }
+  // Not worth waking anyone
+  if(_threads.empty() || count <= grain) {
+    body(0, count, 0);
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(_mutex);
+  _body = &body;
+  _count = count;
+  _grain = grain;
+  _next = 0;
+  _running = _threads.size();
+  ++_generation;
+  lock.unlock();
+  _start.notify_all();
+
+  work(0);
+
+  lock.lock();
+  _done.wait(lock, [this]() {
+    return _running == 0;
+  });
+  _body = nullptr;
+}
+
+void ThreadPool::run(size_t thread) {
+  uint64_t generation = 0;
+  while(true) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _start.wait(lock, [this, generation]() {
+      return _stopping || _generation != generation;
+    });
+    if(_stopping) {
+      return;
+    }
+    generation = _generation;
+    lock.unlock();
+
+    work(thread);
+
+    lock.lock();
+    if(--_running == 0) {
+      _done.notify_one();
+    }
+  }
+}
+
+void ThreadPool::work(size_t thread) {
+  while(true) {
+    size_t begin = _next.fetch_add(_grain);
+    if(begin >= _count) {
+      return;
+    }
+    size_t end = begin + _grain < _count ? begin + _grain : _count;
+    (*_body)(begin, end, thread);
+  }
+}
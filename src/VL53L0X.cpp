@@ -2,6 +2,10 @@
 #include "I2C.hpp"
 
 #include <cerrno>
+// std::isnan(), std::fabs()
+#include <cmath>
+// snprintf(), rename()
+#include <cstdio>
 // strerror()
 #include <cstring>
 // struct timespec, clock_gettime()
@@ -9,6 +13,7 @@
 #include <string>
 #include <unistd.h>
 #include <stdexcept>
+#include <vector>
 
 /*** Defines ***/
 
@@ -28,6 +33,114 @@
 // PLL_period_ps = 1655, macro_period_vclks = 2304
 #define calcMacroPeriod(vcselPeriodPCLKs) ((((uint32_t)2304 * (vcselPeriodPCLKs) * 1655) + 500) / 1000)
 
+// Header of calibration cache files, bump the version whenever VL53L0XCalibration changes
+#define CALIBRATION_FILE_MAGIC "VL53L0X-CAL-1"
+
+// Time between the end of the final range step and the result being flagged, END_OVERHEAD of the timing budget
+#define RANGE_END_OVERHEAD_MICROSECONDS 960
+
+// Reference calibration is repeated when the temperature moved more than this (in degC) since it was cached
+#define MAX_CALIBRATION_TEMPERATURE_DRIFT 8.0f
+
+/*** Data tables ***/
+
+// DefaultTuningSettings from vl53l0x_tuning.h as {register, value} pairs, writes to 0xFF select the register page
+static constexpr uint8_t DEFAULT_TUNING_SETTINGS[][2] = {
+	{0xFF, 0x01},
+	{0x00, 0x00},
+
+	{0xFF, 0x00},
+	{0x09, 0x00},
+	{0x10, 0x00},
+	{0x11, 0x00},
+
+	{0x24, 0x01},
+	{0x25, 0xFF},
+	{0x75, 0x00},
+
+	{0xFF, 0x01},
+	{0x4E, 0x2C},
+	{0x48, 0x00},
+	{0x30, 0x20},
+
+	{0xFF, 0x00},
+	{0x30, 0x09},
+	{0x54, 0x00},
+	{0x31, 0x04},
+	{0x32, 0x03},
+	{0x40, 0x83},
+	{0x46, 0x25},
+	{0x60, 0x00},
+	{0x27, 0x00},
+	{0x50, 0x06},
+	{0x51, 0x00},
+	{0x52, 0x96},
+	{0x56, 0x08},
+	{0x57, 0x30},
+	{0x61, 0x00},
+	{0x62, 0x00},
+	{0x64, 0x00},
+	{0x65, 0x00},
+	{0x66, 0xA0},
+
+	{0xFF, 0x01},
+	{0x22, 0x32},
+	{0x47, 0x14},
+	{0x49, 0xFF},
+	{0x4A, 0x00},
+
+	{0xFF, 0x00},
+	{0x7A, 0x0A},
+	{0x7B, 0x00},
+	{0x78, 0x21},
+
+	{0xFF, 0x01},
+	{0x23, 0x34},
+	{0x42, 0x00},
+	{0x44, 0xFF},
+	{0x45, 0x26},
+	{0x46, 0x05},
+	{0x40, 0x40},
+	{0x0E, 0x06},
+	{0x20, 0x1A},
+	{0x43, 0x40},
+
+	{0xFF, 0x00},
+	{0x34, 0x03},
+	{0x35, 0x44},
+
+	{0xFF, 0x01},
+	{0x31, 0x04},
+	{0x4B, 0x09},
+	{0x4C, 0x05},
+	{0x4D, 0x04},
+
+	{0xFF, 0x00},
+	{0x44, 0x00},
+	{0x45, 0x20},
+	{0x47, 0x08},
+	{0x48, 0x28},
+	{0x67, 0x00},
+	{0x70, 0x04},
+	{0x71, 0x01},
+	{0x72, 0xFE},
+	{0x76, 0x00},
+	{0x77, 0x00},
+
+	{0xFF, 0x01},
+	{0x0D, 0x01},
+
+	{0xFF, 0x00},
+	{0x80, 0x01},
+	{0x01, 0xF8},
+
+	{0xFF, 0x01},
+	{0x8E, 0x01},
+	{0x00, 0x01},
+	{0xFF, 0x00},
+	{0x80, 0x00}
+};
+
 /*** Helper functions ***/
 
 uint64_t milliseconds() {
@@ -36,6 +149,12 @@ uint64_t milliseconds() {
 	return (ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
 }
 
+static uint64_t microseconds() {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
 /*** Constructors ***/
 
 VL53L0X::VL53L0X(I2C &i2c, const int16_t xshutGPIOPin, bool ioMode2v8, const uint8_t address) : _i2c(i2c) {
@@ -48,7 +167,14 @@ VL53L0X::VL53L0X(I2C &i2c, const int16_t xshutGPIOPin, bool ioMode2v8, const uin
 	this->didTimeout = false;
 
 	this->measurementTimingBudgetMicroseconds = 33000;
+	this->rangingStepsMicroseconds = 0;
+	this->interMeasurementPeriodTicks = 0;
+	this->rangeStartMicroseconds = 0;
+	this->lastEmptyPollMicroseconds = 0;
 	this->stopVariable = 0;
+	this->rangePending = false;
+	memset(&this->calibration, 0, sizeof(this->calibration));
+	this->calibration.temperatureCelsius = NAN;
 	this->timeoutStartMilliseconds = milliseconds();
 }
 
@@ -59,6 +185,51 @@ void VL53L0X::initialize() {
 	this->initHardware();
 }
 
+bool VL53L0X::initialize(const std::string &calibrationCacheDirectory, float temperatureCelsius) {
+	this->initGPIO();
+	this->powerOn();
+
+	this->dataInit();
+
+	uint64_t uid;
+	if (!this->getUniqueID(&uid)) {
+		throw(std::runtime_error("Failed retrieving unique ID!"));
+	}
+
+	char uidString[17];
+	snprintf(uidString, sizeof(uidString), "%016llx", (unsigned long long)uid);
+	std::string filename = calibrationCacheDirectory + "/vl53l0x_" + uidString + ".cal";
+
+	VL53L0XCalibration cached;
+	bool useCache = this->loadCalibration(filename, uid, &cached);
+
+	if (useCache) {
+		this->stopVariable = cached.stopVariable;
+		this->calibration = cached;
+		this->staticInit(&cached);
+
+		// "The VHV calibration should be repeated if the temperature changes by more than 8 degC"
+		bool temperatureDrifted = !std::isnan(temperatureCelsius) && !std::isnan(cached.temperatureCelsius)
+			&& std::fabs(temperatureCelsius - cached.temperatureCelsius) > MAX_CALIBRATION_TEMPERATURE_DRIFT;
+		if (!temperatureDrifted) {
+			this->setRefCalibration(cached.vhvSettings, cached.phaseCal);
+			return true;
+		}
+	} else {
+		this->readStopVariable();
+		this->staticInit(nullptr);
+	}
+
+	this->performRefCalibration();
+
+	this->calibration.uid = uid;
+	this->calibration.temperatureCelsius = temperatureCelsius;
+	// A cache that cannot be written only costs the full sequence again on the next start
+	this->saveCalibration(filename);
+
+	return useCache;
+}
+
 void VL53L0X::powerOn() {
 	this->initGPIO();
 
@@ -93,6 +264,9 @@ void VL53L0X::powerOff() {
 		}
 		file << "0";
 		file.close();
+
+		// Hardware standby resets the sensor to its default address
+		this->address = VL53L0X_ADDRESS_DEFAULT;
 	}
 }
 
@@ -188,6 +362,7 @@ bool VL53L0X::setMeasurementTimingBudget(uint32_t budgetMicroseconds) {
 
 	// store for internal reuse
 	this->measurementTimingBudgetMicroseconds = budgetMicroseconds;
+	this->rangingStepsMicroseconds = finalRangeTimeoutMicroseconds + (enables.preRange ? timeouts.preRangeMicroseconds : 0);
 
 	return true;
 }
@@ -226,6 +401,7 @@ uint32_t VL53L0X::getMeasurementTimingBudget() {
 
 	// store for internal reuse
 	this->measurementTimingBudgetMicroseconds = budgetMicroseconds;
+	this->rangingStepsMicroseconds = (enables.finalRange ? timeouts.finalRangeMicroseconds : 0) + (enables.preRange ? timeouts.preRangeMicroseconds : 0);
 	return budgetMicroseconds;
 }
 
@@ -407,6 +583,7 @@ void VL53L0X::startContinuous(uint32_t periodMilliseconds) {
 		}
 
 		this->writeRegister32Bit(SYSTEM_INTERMEASUREMENT_PERIOD, periodMilliseconds);
+		this->interMeasurementPeriodTicks = periodMilliseconds;
 
 		// VL53L0X_SetInterMeasurementPeriodMilliSeconds() end
 
@@ -417,6 +594,15 @@ void VL53L0X::startContinuous(uint32_t periodMilliseconds) {
 		// VL53L0X_REG_SYSRANGE_MODE_BACKTOBACK
 		this->writeRegister(SYSRANGE_START, 0x02);
 	}
+
+	// Only the first measurement's start is known, later ones are bounded by the polls
+	this->rangeStartMicroseconds = microseconds();
+	this->lastEmptyPollMicroseconds = this->rangeStartMicroseconds;
+}
+
+void VL53L0X::setInterMeasurementPeriodTicks(uint32_t ticks) {
+	this->writeRegister32Bit(SYSTEM_INTERMEASUREMENT_PERIOD, ticks);
+	this->interMeasurementPeriodTicks = ticks;
 }
 
 void VL53L0X::stopContinuous() {
@@ -431,29 +617,64 @@ void VL53L0X::stopContinuous() {
 }
 
 uint16_t VL53L0X::readRangeContinuousMillimeters() {
+	VL53L0XRangingMeasurement measurement;
+	if (!this->readRangeContinuous(&measurement)) {
+		return 65535;
+	}
+	return measurement.rangeMillimeters;
+}
+
+uint16_t VL53L0X::readRangeSingleMillimeters() {
+	VL53L0XRangingMeasurement measurement;
+	if (!this->readRangeSingle(&measurement)) {
+		return 65535;
+	}
+	return measurement.rangeMillimeters;
+}
+
+bool VL53L0X::readRangeContinuous(VL53L0XRangingMeasurement* measurement) {
 	startTimeout();
+	uint64_t readMicroseconds = microseconds();
 	while ((this->readRegister(RESULT_INTERRUPT_STATUS) & 0x07) == 0) {
+		this->lastEmptyPollMicroseconds = readMicroseconds;
 		if (checkTimeoutExpired()) {
 			this->didTimeout = true;
-			return 65535;
+			return false;
 		}
 		usleep(1);
+		readMicroseconds = microseconds();
 	}
 
 	// assumptions: Linearity Corrective Gain is 1000 (default);
 	// fractional ranging is not enabled
-	// Note: reading 16-bit register was working on Arduino but here it's not, thus double read and manual addition
-	uint16_t range = this->readRegister16Bit(RESULT_RANGE_STATUS + 10);
-	// uint8_t rangeA = this->readRegister(RESULT_RANGE_STATUS + 10);
-	// uint8_t rangeB = this->readRegister(RESULT_RANGE_STATUS + 11);
-	// uint16_t range = ((uint16_t)(rangeA)<<8) + (uint16_t)(rangeB);
+	uint8_t block[12];
+	this->readRegisterMultiple(RESULT_RANGE_STATUS, block, 12);
+	decodeRangingMeasurement(block, measurement);
+	this->timestampMeasurement(measurement, readMicroseconds, 0);
 
 	this->writeRegister(SYSTEM_INTERRUPT_CLEAR, 0x01);
+	this->rangePending = false;
 
-	return range;
+	return true;
 }
 
-uint16_t VL53L0X::readRangeSingleMillimeters() {
+bool VL53L0X::readRangeSingle(VL53L0XRangingMeasurement* measurement) {
+	this->startRange();
+
+	// "Wait until start bit has been cleared"
+	startTimeout();
+	while (this->readRegister(SYSRANGE_START) & 0x01) {
+		if (checkTimeoutExpired()) {
+			this->didTimeout = true;
+			return false;
+		}
+		usleep(1);
+	}
+
+	return this->readRangeContinuous(measurement);
+}
+
+void VL53L0X::startRange() {
 	this->writeRegister(0x80, 0x01);
 	this->writeRegister(0xFF, 0x01);
 	this->writeRegister(0x00, 0x00);
@@ -464,17 +685,57 @@ uint16_t VL53L0X::readRangeSingleMillimeters() {
 
 	this->writeRegister(SYSRANGE_START, 0x01);
 
-	// "Wait until start bit has been cleared"
-	startTimeout();
-	while (this->readRegister(SYSRANGE_START) & 0x01) {
-		if (checkTimeoutExpired()) {
-			this->didTimeout = true;
-			return 65535;
-		}
-		usleep(1);
+	this->rangeStartMicroseconds = microseconds();
+	this->lastEmptyPollMicroseconds = this->rangeStartMicroseconds;
+	this->rangePending = true;
+}
+
+bool VL53L0X::tryGetResult(uint16_t* rangeMillimeters) {
+	VL53L0XRangingMeasurement measurement;
+	if (!this->tryGetResult(&measurement)) {
+		return false;
 	}
+	*rangeMillimeters = measurement.rangeMillimeters;
+	return true;
+}
 
-	return readRangeContinuousMillimeters();
+bool VL53L0X::tryGetResult(VL53L0XRangingMeasurement* measurement, uint64_t interruptMicroseconds) {
+	// RESULT_INTERRUPT_STATUS is directly followed by the RESULT_RANGE_STATUS block,
+	// so status and result come in one read: 1 status byte + 12 bytes of range status.
+	// The register pointer write and the read go out as one combined transaction
+	uint8_t reg = RESULT_INTERRUPT_STATUS;
+	uint8_t buffer[13];
+	I2CMessage messages[2];
+	messages[0].device_address = this->address;
+	messages[0].read = false;
+	messages[0].data = &reg;
+	messages[0].length = 1;
+	messages[1].device_address = this->address;
+	messages[1].read = true;
+	messages[1].data = buffer;
+	messages[1].length = sizeof(buffer);
+
+	uint64_t readMicroseconds = microseconds();
+	if (!_i2c.transfer(messages, 2)) {
+		return false;
+	}
+
+	if ((buffer[0] & 0x07) == 0) {
+		this->lastEmptyPollMicroseconds = readMicroseconds;
+		return false;
+	}
+
+	decodeRangingMeasurement(&buffer[1], measurement);
+	this->timestampMeasurement(measurement, readMicroseconds, interruptMicroseconds);
+
+	this->writeRegister(SYSTEM_INTERRUPT_CLEAR, 0x01);
+	this->rangePending = false;
+
+	if (this->rangeCallback) {
+		this->rangeCallback(*measurement);
+	}
+
+	return true;
 }
 
 bool VL53L0X::timeoutOccurred() {
@@ -527,6 +788,13 @@ void VL53L0X::initHardware() {
 	// Enable the sensor
 	this->powerOn();
 
+	this->dataInit();
+	this->readStopVariable();
+	this->staticInit(nullptr);
+	this->performRefCalibration();
+}
+
+void VL53L0X::dataInit() {
 	// VL53L0X_DataInit() begin
 
 	// Sensor uses 1V8 mode for I/O by default; switch to 2V8 mode if necessary
@@ -538,14 +806,6 @@ void VL53L0X::initHardware() {
 	// "Set I2C standard mode"
 	this->writeRegister(0x88, 0x00);
 
-	this->writeRegister(0x80, 0x01);
-	this->writeRegister(0xFF, 0x01);
-	this->writeRegister(0x00, 0x00);
-	this->stopVariable = this->readRegister(0x91);
-	this->writeRegister(0x00, 0x01);
-	this->writeRegister(0xFF, 0x00);
-	this->writeRegister(0x80, 0x00);
-
 	// disable SIGNAL_RATE_MSRC (bit 1) and SIGNAL_RATE_PRE_RANGE (bit 4) limit checks
 	this->writeRegister(MSRC_CONFIG_CONTROL, this->readRegister(MSRC_CONFIG_CONTROL) | 0x12);
 
@@ -555,19 +815,51 @@ void VL53L0X::initHardware() {
 	this->writeRegister(SYSTEM_SEQUENCE_CONFIG, 0xFF);
 
 	// VL53L0X_DataInit() end
+}
+
+void VL53L0X::readStopVariable() {
+	// Part of VL53L0X_DataInit()
+	this->writeRegister(0x80, 0x01);
+	this->writeRegister(0xFF, 0x01);
+	this->writeRegister(0x00, 0x00);
+	this->stopVariable = this->readRegister(0x91);
+	this->writeRegister(0x00, 0x01);
+	this->writeRegister(0xFF, 0x00);
+	this->writeRegister(0x80, 0x00);
+
+	this->calibration.stopVariable = this->stopVariable;
+}
 
+void VL53L0X::staticInit(const VL53L0XCalibration* cached) {
 	// VL53L0X_StaticInit() begin
 
-	uint8_t spadCount;
-	bool spadTypeIsAperture;
-	if (!this->getSPADInfo(&spadCount, &spadTypeIsAperture)) {
-		throw(std::runtime_error("Failed retrieving SPAD info!"));
-	}
+	if (cached != nullptr) {
+		memcpy(this->calibration.refSPADMap, cached->refSPADMap, 6);
+	} else {
+		uint8_t spadCount;
+		bool spadTypeIsAperture;
+		if (!this->getSPADInfo(&spadCount, &spadTypeIsAperture)) {
+			throw(std::runtime_error("Failed retrieving SPAD info!"));
+		}
 
-	// The SPAD map (RefGoodSpadMap) is read by VL53L0X_get_info_from_device() in the API,
-	// but the same data seems to be more easily readable from GLOBAL_CONFIG_SPAD_ENABLES_REF_0 through _6, so read it from there
-	uint8_t refSPADMap[6];
-	this->readRegisterMultiple(GLOBAL_CONFIG_SPAD_ENABLES_REF_0, refSPADMap, 6);
+		// The SPAD map (RefGoodSpadMap) is read by VL53L0X_get_info_from_device() in the API,
+		// but the same data seems to be more easily readable from GLOBAL_CONFIG_SPAD_ENABLES_REF_0 through _6, so read it from there
+		uint8_t* refSPADMap = this->calibration.refSPADMap;
+		this->readRegisterMultiple(GLOBAL_CONFIG_SPAD_ENABLES_REF_0, refSPADMap, 6);
+
+		// 12 is the first aperture spad
+		uint8_t firstSPADToEnable = spadTypeIsAperture ? 12 : 0;
+		uint8_t spadsEnabled = 0;
+
+		for (uint8_t i = 0; i < 48; i++) {
+			if (i < firstSPADToEnable || spadsEnabled == spadCount) {
+				// This bit is lower than the first one that should be enabled, or (reference_spad_count) bits have already been enabled, so zero this bit
+				refSPADMap[i / 8] &= ~(1 << (i % 8));
+			} else if ((refSPADMap[i / 8] >> (i % 8)) & 0x1) {
+				spadsEnabled++;
+			}
+		}
+	}
 
 	// -- VL53L0X_set_reference_spads() begin (assume NVM values are valid)
 
@@ -577,121 +869,11 @@ void VL53L0X::initHardware() {
 	this->writeRegister(0xFF, 0x00);
 	this->writeRegister(GLOBAL_CONFIG_REF_EN_START_SELECT, 0xB4);
 
-	// 12 is the first aperture spad
-	uint8_t firstSPADToEnable = spadTypeIsAperture ? 12 : 0;
-	uint8_t spadsEnabled = 0;
-
-	for (uint8_t i = 0; i < 48; i++) {
-		if (i < firstSPADToEnable || spadsEnabled == spadCount) {
-			// This bit is lower than the first one that should be enabled, or (reference_spad_count) bits have already been enabled, so zero this bit
-			refSPADMap[i / 8] &= ~(1 << (i % 8));
-		} else if ((refSPADMap[i / 8] >> (i % 8)) & 0x1) {
-			spadsEnabled++;
-		}
-	}
-
-	this->writeRegisterMultiple(GLOBAL_CONFIG_SPAD_ENABLES_REF_0, refSPADMap, 6);
+	this->writeRegisterMultiple(GLOBAL_CONFIG_SPAD_ENABLES_REF_0, this->calibration.refSPADMap, 6);
 
 	// -- VL53L0X_set_reference_spads() end
 
-	// -- VL53L0X_load_tuning_settings() begin
-	// DefaultTuningSettings from vl53l0x_tuning.h
-
-	this->writeRegister(0xFF, 0x01);
-	this->writeRegister(0x00, 0x00);
-
-	this->writeRegister(0xFF, 0x00);
-	this->writeRegister(0x09, 0x00);
-	this->writeRegister(0x10, 0x00);
-	this->writeRegister(0x11, 0x00);
-
-	this->writeRegister(0x24, 0x01);
-	this->writeRegister(0x25, 0xFF);
-	this->writeRegister(0x75, 0x00);
-
-	this->writeRegister(0xFF, 0x01);
-	this->writeRegister(0x4E, 0x2C);
-	this->writeRegister(0x48, 0x00);
-	this->writeRegister(0x30, 0x20);
-
-	this->writeRegister(0xFF, 0x00);
-	this->writeRegister(0x30, 0x09);
-	this->writeRegister(0x54, 0x00);
-	this->writeRegister(0x31, 0x04);
-	this->writeRegister(0x32, 0x03);
-	this->writeRegister(0x40, 0x83);
-	this->writeRegister(0x46, 0x25);
-	this->writeRegister(0x60, 0x00);
-	this->writeRegister(0x27, 0x00);
-	this->writeRegister(0x50, 0x06);
-	this->writeRegister(0x51, 0x00);
-	this->writeRegister(0x52, 0x96);
-	this->writeRegister(0x56, 0x08);
-	this->writeRegister(0x57, 0x30);
-	this->writeRegister(0x61, 0x00);
-	this->writeRegister(0x62, 0x00);
-	this->writeRegister(0x64, 0x00);
-	this->writeRegister(0x65, 0x00);
-	this->writeRegister(0x66, 0xA0);
-
-	this->writeRegister(0xFF, 0x01);
-	this->writeRegister(0x22, 0x32);
-	this->writeRegister(0x47, 0x14);
-	this->writeRegister(0x49, 0xFF);
-	this->writeRegister(0x4A, 0x00);
-
-	this->writeRegister(0xFF, 0x00);
-	this->writeRegister(0x7A, 0x0A);
-	this->writeRegister(0x7B, 0x00);
-	this->writeRegister(0x78, 0x21);
-
-	this->writeRegister(0xFF, 0x01);
-	this->writeRegister(0x23, 0x34);
-	this->writeRegister(0x42, 0x00);
-	this->writeRegister(0x44, 0xFF);
-	this->writeRegister(0x45, 0x26);
-	this->writeRegister(0x46, 0x05);
-	this->writeRegister(0x40, 0x40);
-	this->writeRegister(0x0E, 0x06);
-	this->writeRegister(0x20, 0x1A);
-	this->writeRegister(0x43, 0x40);
-
-	this->writeRegister(0xFF, 0x00);
-	this->writeRegister(0x34, 0x03);
-	this->writeRegister(0x35, 0x44);
-
-	this->writeRegister(0xFF, 0x01);
-	this->writeRegister(0x31, 0x04);
-	this->writeRegister(0x4B, 0x09);
-	this->writeRegister(0x4C, 0x05);
-	this->writeRegister(0x4D, 0x04);
-
-	this->writeRegister(0xFF, 0x00);
-	this->writeRegister(0x44, 0x00);
-	this->writeRegister(0x45, 0x20);
-	this->writeRegister(0x47, 0x08);
-	this->writeRegister(0x48, 0x28);
-	this->writeRegister(0x67, 0x00);
-	this->writeRegister(0x70, 0x04);
-	this->writeRegister(0x71, 0x01);
-	this->writeRegister(0x72, 0xFE);
-	this->writeRegister(0x76, 0x00);
-	this->writeRegister(0x77, 0x00);
-
-	this->writeRegister(0xFF, 0x01);
-	this->writeRegister(0x0D, 0x01);
-
-	this->writeRegister(0xFF, 0x00);
-	this->writeRegister(0x80, 0x01);
-	this->writeRegister(0x01, 0xF8);
-
-	this->writeRegister(0xFF, 0x01);
-	this->writeRegister(0x8E, 0x01);
-	this->writeRegister(0x00, 0x01);
-	this->writeRegister(0xFF, 0x00);
-	this->writeRegister(0x80, 0x00);
-
-	// -- VL53L0X_load_tuning_settings() end
+	this->loadTuningSettings();
 
 	// "Set interrupt config to new sample ready"
 	// -- VL53L0X_SetGpioConfig() begin
@@ -703,22 +885,55 @@ void VL53L0X::initHardware() {
 
 	// -- VL53L0X_SetGpioConfig() end
 
-	this->measurementTimingBudgetMicroseconds = this->getMeasurementTimingBudget();
+	if (cached != nullptr) {
+		// Same sequence config as below, and the final range timeout it produced, written back directly
+		this->writeRegister(SYSTEM_SEQUENCE_CONFIG, 0xE8);
+		this->writeRegister16Bit(FINAL_RANGE_CONFIG_TIMEOUT_MACROP_HI, cached->finalRangeTimeout);
+		this->measurementTimingBudgetMicroseconds = cached->measurementTimingBudgetMicroseconds;
+
+		VL53L0XSequenceStepEnables enables;
+		VL53L0XSequenceStepTimeouts timeouts;
+		this->getSequenceStepEnables(&enables);
+		this->getSequenceStepTimeouts(&enables, &timeouts);
+		this->rangingStepsMicroseconds = timeouts.finalRangeMicroseconds + timeouts.preRangeMicroseconds;
+	} else {
+		this->measurementTimingBudgetMicroseconds = this->getMeasurementTimingBudget();
+
+		// "Disable MSRC and TCC by default"
+		// MSRC = Minimum Signal Rate Check
+		// TCC = Target CentreCheck
+		// -- VL53L0X_SetSequenceStepEnable() begin
 
-	// "Disable MSRC and TCC by default"
-	// MSRC = Minimum Signal Rate Check
-	// TCC = Target CentreCheck
-	// -- VL53L0X_SetSequenceStepEnable() begin
+		this->writeRegister(SYSTEM_SEQUENCE_CONFIG, 0xE8);
 
-	this->writeRegister(SYSTEM_SEQUENCE_CONFIG, 0xE8);
+		// -- VL53L0X_SetSequenceStepEnable() end
 
-	// -- VL53L0X_SetSequenceStepEnable() end
+		// "Recalculate timing budget"
+		this->setMeasurementTimingBudget(this->measurementTimingBudgetMicroseconds);
+	}
 
-	// "Recalculate timing budget"
-	this->setMeasurementTimingBudget(this->measurementTimingBudgetMicroseconds);
+	this->calibration.finalRangeTimeout = this->readRegister16Bit(FINAL_RANGE_CONFIG_TIMEOUT_MACROP_HI);
+	this->calibration.measurementTimingBudgetMicroseconds = this->measurementTimingBudgetMicroseconds;
 
 	// VL53L0X_StaticInit() end
+}
+
+void VL53L0X::loadTuningSettings(bool batched) {
+	// -- VL53L0X_load_tuning_settings() begin
+
+	size_t length = sizeof(DEFAULT_TUNING_SETTINGS) / sizeof(DEFAULT_TUNING_SETTINGS[0]);
+	if (batched) {
+		this->writeRegisterTable(DEFAULT_TUNING_SETTINGS, length);
+	} else {
+		for (size_t i = 0; i < length; ++i) {
+			this->writeRegister(DEFAULT_TUNING_SETTINGS[i][0], DEFAULT_TUNING_SETTINGS[i][1]);
+		}
+	}
+
+	// -- VL53L0X_load_tuning_settings() end
+}
 
+void VL53L0X::performRefCalibration() {
 	// VL53L0X_PerformRefCalibration() begin (VL53L0X_perform_ref_calibration())
 
 	// -- VL53L0X_perform_vhv_calibration() begin
@@ -743,11 +958,53 @@ void VL53L0X::initHardware() {
 	this->writeRegister(SYSTEM_SEQUENCE_CONFIG, 0xE8);
 
 	// VL53L0X_PerformRefCalibration() end
+
+	this->getRefCalibration(&this->calibration.vhvSettings, &this->calibration.phaseCal);
 }
 
 bool VL53L0X::getSPADInfo(uint8_t* count, bool* typeIsAperture) {
 	uint8_t tmp;
 
+	this->beginNVMAccess();
+
+	this->writeRegister(0x94, 0x6b);
+	if (!this->strobeNVMRead()) {
+		return false;
+	}
+	tmp = this->readRegister(0x92);
+
+	*count = tmp & 0x7f;
+	*typeIsAperture = (tmp >> 7) & 0x01;
+
+	this->endNVMAccess();
+
+	return true;
+}
+
+bool VL53L0X::getUniqueID(uint64_t* uid) {
+	this->beginNVMAccess();
+
+	// PartUIDUpper
+	this->writeRegister(0x94, 0x7B);
+	if (!this->strobeNVMRead()) {
+		return false;
+	}
+	uint64_t upper = this->readRegister32Bit(0x90);
+
+	// PartUIDLower
+	this->writeRegister(0x94, 0x7C);
+	if (!this->strobeNVMRead()) {
+		return false;
+	}
+	uint64_t lower = this->readRegister32Bit(0x90);
+
+	this->endNVMAccess();
+
+	*uid = (upper << 32) | lower;
+	return true;
+}
+
+void VL53L0X::beginNVMAccess() {
 	this->writeRegister(0x80, 0x01);
 	this->writeRegister(0xFF, 0x01);
 	this->writeRegister(0x00, 0x00);
@@ -758,8 +1015,10 @@ bool VL53L0X::getSPADInfo(uint8_t* count, bool* typeIsAperture) {
 	this->writeRegister(0x81, 0x01);
 
 	this->writeRegister(0x80, 0x01);
+}
 
-	this->writeRegister(0x94, 0x6b);
+bool VL53L0X::strobeNVMRead() {
+	// Based on VL53L0X_device_read_strobe()
 	this->writeRegister(0x83, 0x00);
 	startTimeout();
 	while (this->readRegister(0x83) == 0x00) {
@@ -769,11 +1028,10 @@ bool VL53L0X::getSPADInfo(uint8_t* count, bool* typeIsAperture) {
 		usleep(1);
 	}
 	this->writeRegister(0x83, 0x01);
-	tmp = this->readRegister(0x92);
-
-	*count = tmp & 0x7f;
-	*typeIsAperture = (tmp >> 7) & 0x01;
+	return true;
+}
 
+void VL53L0X::endNVMAccess() {
 	this->writeRegister(0x81, 0x00);
 	this->writeRegister(0xFF, 0x06);
 	this->writeRegister(0x83, this->readRegister(0x83) & ~0x04);
@@ -782,8 +1040,69 @@ bool VL53L0X::getSPADInfo(uint8_t* count, bool* typeIsAperture) {
 
 	this->writeRegister(0xFF, 0x00);
 	this->writeRegister(0x80, 0x00);
+}
 
-	return true;
+void VL53L0X::getRefCalibration(uint8_t* vhvSettings, uint8_t* phaseCal) {
+	// VL53L0X_ref_calibration_io() (read)
+	this->writeRegister(0xFF, 0x01);
+	this->writeRegister(0x00, 0x00);
+	this->writeRegister(0xFF, 0x00);
+
+	*vhvSettings = this->readRegister(0xCB);
+	*phaseCal = this->readRegister(0xEE);
+
+	this->writeRegister(0xFF, 0x01);
+	this->writeRegister(0x00, 0x01);
+	this->writeRegister(0xFF, 0x00);
+}
+
+void VL53L0X::setRefCalibration(uint8_t vhvSettings, uint8_t phaseCal) {
+	// VL53L0X_ref_calibration_io() (write), only the low 7 bits hold the calibration
+	this->writeRegister(0xFF, 0x01);
+	this->writeRegister(0x00, 0x00);
+	this->writeRegister(0xFF, 0x00);
+
+	this->writeRegister(0xCB, (this->readRegister(0xCB) & 0x80) | (vhvSettings & 0x7F));
+	this->writeRegister(0xEE, (this->readRegister(0xEE) & 0x80) | (phaseCal & 0x7F));
+
+	this->writeRegister(0xFF, 0x01);
+	this->writeRegister(0x00, 0x01);
+	this->writeRegister(0xFF, 0x00);
+}
+
+bool VL53L0X::loadCalibration(const std::string &filename, uint64_t uid, VL53L0XCalibration* calibration) {
+	std::ifstream file(filename.c_str(), std::ifstream::in | std::ifstream::binary);
+	if (!file.is_open()) {
+		return false;
+	}
+
+	char magic[sizeof(CALIBRATION_FILE_MAGIC)];
+	file.read(magic, sizeof(magic));
+	file.read((char*)calibration, sizeof(VL53L0XCalibration));
+	if (!file.good() || memcmp(magic, CALIBRATION_FILE_MAGIC, sizeof(magic)) != 0) {
+		return false;
+	}
+
+	// Guard against a file copied over from another sensor
+	return calibration->uid == uid;
+}
+
+bool VL53L0X::saveCalibration(const std::string &filename) {
+	// Write to a temporary file and rename it, so an interrupted start never leaves a truncated cache behind
+	std::string temporaryFilename = filename + ".tmp";
+	std::ofstream file(temporaryFilename.c_str(), std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+	if (!file.is_open()) {
+		return false;
+	}
+
+	file.write(CALIBRATION_FILE_MAGIC, sizeof(CALIBRATION_FILE_MAGIC));
+	file.write((const char*)&this->calibration, sizeof(VL53L0XCalibration));
+	file.close();
+	if (!file.good()) {
+		return false;
+	}
+
+	return rename(temporaryFilename.c_str(), filename.c_str()) == 0;
 }
 
 void VL53L0X::getSequenceStepEnables(VL53L0XSequenceStepEnables* enables) {
@@ -816,6 +1135,70 @@ void VL53L0X::getSequenceStepTimeouts(const VL53L0XSequenceStepEnables * enables
 	timeouts->finalRangeMicroseconds = this->timeoutMclksToMicroseconds(timeouts->finalRangeMCLKs, timeouts->finalRangeVCSELPeriodPCLKs);
 }
 
+void VL53L0X::timestampMeasurement(VL53L0XRangingMeasurement* measurement, uint64_t readMicroseconds, uint64_t interruptMicroseconds) {
+	uint64_t completedMicroseconds = interruptMicroseconds;
+
+	if (completedMicroseconds == 0) {
+		// Polled: the result was flagged after the last poll that found nothing
+		// (and, for a single-shot measurement, no earlier than a full budget after its start) but before this read
+		uint64_t earliestMicroseconds = this->lastEmptyPollMicroseconds;
+		if (this->rangePending && this->rangeStartMicroseconds + this->measurementTimingBudgetMicroseconds > earliestMicroseconds) {
+			earliestMicroseconds = this->rangeStartMicroseconds + this->measurementTimingBudgetMicroseconds;
+		}
+		if (earliestMicroseconds == 0 || earliestMicroseconds > readMicroseconds) {
+			earliestMicroseconds = readMicroseconds;
+		}
+		completedMicroseconds = earliestMicroseconds + (readMicroseconds - earliestMicroseconds) / 2;
+	}
+
+	// Photons are integrated during the pre-range and final range steps, which end shortly before the result is flagged
+	measurement->exposureEndMicroseconds = completedMicroseconds - RANGE_END_OVERHEAD_MICROSECONDS;
+	measurement->exposureStartMicroseconds = measurement->exposureEndMicroseconds - this->rangingStepsMicroseconds;
+	measurement->exposureMidMicroseconds = measurement->exposureStartMicroseconds + this->rangingStepsMicroseconds / 2;
+
+	// The next result can't be flagged before this one is collected
+	this->lastEmptyPollMicroseconds = readMicroseconds;
+}
+
+void VL53L0X::decodeRangingMeasurement(const uint8_t* block, VL53L0XRangingMeasurement* measurement) {
+	// Layout as read by VL53L0X_GetRangingMeasurementData(), all fields big endian
+	uint8_t deviceRangeStatus = (block[0] & 0x78) >> 3;
+
+	measurement->rangeMillimeters = ((uint16_t)block[10] << 8) | block[11];
+	measurement->deviceRangeStatus = deviceRangeStatus;
+	// 8.8 fixed point
+	measurement->effectiveSPADReturnCount = ((uint16_t)block[2] << 8) | block[3];
+	// Q9.7 fixed point, like the signal rate limit
+	measurement->signalRateMCPS = (float)(((uint16_t)block[6] << 8) | block[7]) / (1 << 7);
+	measurement->ambientRateMCPS = (float)(((uint16_t)block[8] << 8) | block[9]) / (1 << 7);
+
+	// VL53L0X_get_pal_range_status(), without the sigma, signal ref clip and range ignore checks (disabled by default)
+	switch (deviceRangeStatus) {
+		case 11:
+			measurement->rangeStatus = RangeValid;
+			break;
+		case 4:
+			measurement->rangeStatus = RangeSignalFail;
+			break;
+		case 8:
+		case 10:
+			measurement->rangeStatus = RangeMinRangeFail;
+			break;
+		case 6:
+		case 9:
+			measurement->rangeStatus = RangePhaseFail;
+			break;
+		case 1:
+		case 2:
+		case 3:
+			measurement->rangeStatus = RangeHardwareFail;
+			break;
+		default:
+			measurement->rangeStatus = RangeNone;
+			break;
+	}
+}
+
 uint16_t VL53L0X::decodeTimeout(uint16_t registerValue) {
 	// format: "(LSByte * 2^MSByte) + 1"
 	return (uint16_t)((registerValue & 0x00FF) << (uint16_t)((registerValue & 0xFF00) >> 8)) + 1;
@@ -880,8 +1263,12 @@ void VL53L0X::writeRegister(uint8_t reg, uint8_t value) {
 }
 
 void VL53L0X::writeRegister16Bit(uint8_t reg, uint16_t value) {
-	// No need to reverse endinaness as writeWord does that for us
-	bool p = _i2c.write_register(this->address, reg, (uint8_t *)&value, 2);
+	// Registers are big endian
+	uint8_t data[2];
+	data[0] = (value >> 8) & 0xFF;
+	data[1] = value & 0xFF;
+
+	bool p = _i2c.write_register(this->address, reg, data, 2);
 	if (!p) {
 		throw(std::runtime_error(std::string("Error writing word to register: ") + strerror(errno)));
 	}
@@ -890,28 +1277,56 @@ void VL53L0X::writeRegister16Bit(uint8_t reg, uint16_t value) {
 void VL53L0X::writeRegister32Bit(uint8_t reg, uint32_t value) {
 	// Split 32-bit word into MS ... LS bytes
 	uint8_t data[4];
-	data[0] = value & 0xFF;
-	data[1] = (value >> 8) & 0xFF;
-	data[2] = (value >> 16) & 0xFF;
-	data[3] = (value >> 24) & 0xFF;
+	data[0] = (value >> 24) & 0xFF;
+	data[1] = (value >> 16) & 0xFF;
+	data[2] = (value >> 8) & 0xFF;
+	data[3] = value & 0xFF;
 
-	bool p = _i2c.write_register(this->address, reg, (uint8_t *)&value, 4);
+	bool p = _i2c.write_register(this->address, reg, data, 4);
 	if (!p) {
 		throw(std::runtime_error("Error writing dword to register"));
 	}
 }
 
 void VL53L0X::writeRegisterMultiple(uint8_t reg, const uint8_t* source, uint8_t count) {
-	uint8_t data[4];
-	for (uint8_t i = 0; i < 4; ++i) {
-		data[i] = source[i];
-	}
-	bool p = _i2c.write_register(this->address, reg, data, count);
+	bool p = _i2c.write_register(this->address, reg, (uint8_t *)source, count);
 	if (!p) {
 		throw(std::runtime_error("Error writing block to register"));
 	}
 }
 
+void VL53L0X::writeRegisterTable(const uint8_t (*table)[2], size_t length) {
+	// Coalesce runs of consecutive registers into one burst each (the register index auto-increments),
+	// page selects always go alone so no burst crosses a page change
+	std::vector<uint8_t> buffer(2 * length);
+	std::vector<I2CMessage> messages;
+	messages.reserve(length);
+
+	size_t used = 0;
+	for (size_t i = 0; i < length; ++i) {
+		uint8_t reg = table[i][0];
+		bool extendsRun = !messages.empty() && reg != 0xFF && table[i - 1][0] != 0xFF && reg == table[i - 1][0] + 1;
+
+		if (extendsRun) {
+			messages.back().length++;
+		} else {
+			I2CMessage message;
+			message.device_address = this->address;
+			message.read = false;
+			message.data = &buffer[used];
+			message.length = 1;
+			messages.push_back(message);
+			buffer[used++] = reg;
+			messages.back().length++;
+		}
+		buffer[used++] = table[i][1];
+	}
+
+	if (!_i2c.transfer(messages.data(), messages.size())) {
+		throw(std::runtime_error(std::string("Error writing register table: ") + strerror(errno)));
+	}
+}
+
 uint8_t VL53L0X::readRegister(uint8_t reg) {
 	uint8_t data;
 	_i2c.write_register(this->address, reg, &data, 0);
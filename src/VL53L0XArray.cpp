@@ -0,0 +1,131 @@
+#include "VL53L0XArray.hpp"
+
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <thread>
+// struct timespec, clock_gettime(), clock_nanosleep()
+#include <ctime>
+
+/*** Constructors ***/
+
+VL53L0XArray::VL53L0XArray(I2C &i2c, const std::vector<int16_t> &xshutGPIOPins, uint8_t firstAddress, bool ioMode2v8) : _i2c(i2c) {
+	size_t count = xshutGPIOPins.size();
+
+	if (count == 0 || firstAddress + count - 1 > 0x7F) {
+		throw(std::runtime_error("Invalid address range for sensor array"));
+	}
+	if (VL53L0X_ADDRESS_DEFAULT >= firstAddress && VL53L0X_ADDRESS_DEFAULT < firstAddress + count) {
+		throw(std::runtime_error("Sensor array address range includes the default address"));
+	}
+
+	this->firstAddress = firstAddress;
+
+	for (size_t i = 0; i < count; ++i) {
+		if (xshutGPIOPins[i] < 0) {
+			throw(std::runtime_error(std::string("Missing XSHUT pin for sensor ") + std::to_string(i)));
+		}
+		this->sensors.emplace_back(new VL53L0X(i2c, xshutGPIOPins[i], ioMode2v8, VL53L0X_ADDRESS_DEFAULT));
+	}
+}
+
+/*** Public Methods ***/
+
+void VL53L0XArray::initialize() {
+	this->assignAddresses();
+	this->initializeConcurrently([](VL53L0X &sensor) {
+		sensor.initialize();
+	});
+}
+
+void VL53L0XArray::initialize(const std::string &calibrationCacheDirectory, float temperatureCelsius) {
+	this->assignAddresses();
+	this->initializeConcurrently([&calibrationCacheDirectory, temperatureCelsius](VL53L0X &sensor) {
+		sensor.initialize(calibrationCacheDirectory, temperatureCelsius);
+	});
+}
+
+void VL53L0XArray::startStaggered(uint32_t periodMilliseconds) {
+	uint64_t offsetNanoseconds = (uint64_t)periodMilliseconds * 1000000 / this->sensors.size();
+
+	timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (size_t i = 0; i < this->sensors.size(); ++i) {
+		uint64_t delayNanoseconds = start.tv_nsec + i * offsetNanoseconds;
+		timespec wakeup;
+		wakeup.tv_sec = start.tv_sec + delayNanoseconds / 1000000000;
+		wakeup.tv_nsec = delayNanoseconds % 1000000000;
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wakeup, nullptr) != 0) {
+			// interrupted by a signal, sleep again until the start slot
+		}
+
+		this->sensors[i]->startContinuous(periodMilliseconds);
+	}
+}
+
+void VL53L0XArray::stopContinuous() {
+	for (auto &sensor : this->sensors) {
+		sensor->stopContinuous();
+	}
+}
+
+size_t VL53L0XArray::poll(std::function<void(size_t, const VL53L0XRangingMeasurement&)> callback) {
+	size_t collected = 0;
+	VL53L0XRangingMeasurement measurement;
+
+	for (size_t i = 0; i < this->sensors.size(); ++i) {
+		if (this->sensors[i]->tryGetResult(&measurement)) {
+			callback(i, measurement);
+			collected++;
+		}
+	}
+
+	return collected;
+}
+
+void VL53L0XArray::powerOff() {
+	for (auto &sensor : this->sensors) {
+		sensor->powerOff();
+	}
+}
+
+/*** Private Methods ***/
+
+void VL53L0XArray::assignAddresses() {
+	// Hold every sensor in reset so none of them answers at the default address
+	for (auto &sensor : this->sensors) {
+		sensor->powerOff();
+	}
+
+	// Wake one sensor at a time and move it off the default address before releasing the next one
+	for (size_t i = 0; i < this->sensors.size(); ++i) {
+		this->sensors[i]->powerOn();
+		this->sensors[i]->setAddress(this->firstAddress + i);
+	}
+}
+
+void VL53L0XArray::initializeConcurrently(std::function<void(VL53L0X&)> initializer) {
+	// Addresses are unique now, so all sensors can be initialized at the same time
+	std::vector<std::exception_ptr> errors(this->sensors.size());
+	std::vector<std::thread> threads;
+
+	for (size_t i = 0; i < this->sensors.size(); ++i) {
+		threads.emplace_back([this, &errors, &initializer, i]() {
+			try {
+				initializer(*this->sensors[i]);
+			} catch (...) {
+				errors[i] = std::current_exception();
+			}
+		});
+	}
+	for (auto &thread : threads) {
+		thread.join();
+	}
+
+	for (auto &error : errors) {
+		if (error) {
+			std::rethrow_exception(error);
+		}
+	}
+}
@@ -0,0 +1,140 @@
+#include "VL53L0XPhaseLock.hpp"
+
+// std::fabs(), std::fmod(), std::isfinite(), std::lround()
+#include <cmath>
+
+/*** Defines ***/
+
+// Samples of each clock needed before trimming
+#define PHASE_LOCK_MIN_SAMPLES 8
+
+// Share of the measured phase error removed by each trim, and weight of the accumulated error
+#define PHASE_LOCK_PROPORTIONAL_GAIN 0.5f
+#define PHASE_LOCK_INTEGRAL_GAIN 0.05f
+
+// Largest change of the period a single trim may apply, relative to the nominal period
+#define PHASE_LOCK_MAX_TRIM 0.02f
+
+/*** Constructors ***/
+
+VL53L0XPhaseLock::VL53L0XPhaseLock(VL53L0X &sensor, uint32_t imuSamplesPerRange, float phase, uint32_t trimEveryRanges) : sensor(sensor) {
+	this->imuSamplesPerRange = imuSamplesPerRange;
+	this->phase = phase;
+	this->trimEveryRanges = trimEveryRanges > 0 ? trimEveryRanges : 1;
+
+	this->imuCount = 0;
+	this->rangeCount = 0;
+
+	this->ticksPerMicrosecond = 0;
+	this->phaseErrorMicroseconds = 0;
+	this->phaseErrorSum = 0;
+	this->phaseErrorIntegral = 0;
+	this->rangesSinceTrim = 0;
+}
+
+/*** Public Methods ***/
+
+void VL53L0XPhaseLock::addImuSample(uint64_t timestampMicroseconds) {
+	this->imuTimestamps[this->imuCount % PHASE_LOCK_WINDOW] = timestampMicroseconds;
+	this->imuCount++;
+}
+
+bool VL53L0XPhaseLock::addRange(uint64_t timestampMicroseconds) {
+	this->rangeTimestamps[this->rangeCount % PHASE_LOCK_WINDOW] = timestampMicroseconds;
+	this->rangeTicks[this->rangeCount % PHASE_LOCK_WINDOW] = this->sensor.getInterMeasurementPeriodTicks();
+	this->rangeCount++;
+
+	if (!this->isLocked()) {
+		return false;
+	}
+
+	// Oscillator rate: ticks the sensor was told to wait over the host time it actually took, across the window
+	uint32_t samples = this->rangeCount < PHASE_LOCK_WINDOW ? this->rangeCount : PHASE_LOCK_WINDOW;
+	uint64_t oldest = this->rangeTimestamps[(this->rangeCount - samples) % PHASE_LOCK_WINDOW];
+	double ticks = 0;
+	for (uint32_t i = this->rangeCount - samples + 1; i < this->rangeCount; ++i) {
+		ticks += this->rangeTicks[i % PHASE_LOCK_WINDOW];
+	}
+	if (timestampMicroseconds <= oldest) {
+		return false;
+	}
+	this->ticksPerMicrosecond = ticks / (timestampMicroseconds - oldest);
+
+	// Phase of this range within the IMU sample period, relative to the wanted one and wrapped to [-T/2, T/2)
+	double imuPeriod = this->getImuPeriod();
+	if (!(imuPeriod > 0)) {
+		// Stalled or replayed IMU clock, there is no phase to lock to
+		return false;
+	}
+	double lastImuSample = this->imuTimestamps[(this->imuCount - 1) % PHASE_LOCK_WINDOW];
+	double error = std::fmod((double)timestampMicroseconds - lastImuSample - this->phase * imuPeriod, imuPeriod);
+	if (error < -imuPeriod / 2) {
+		error += imuPeriod;
+	} else if (error >= imuPeriod / 2) {
+		error -= imuPeriod;
+	}
+
+	this->phaseErrorMicroseconds = error;
+	this->phaseErrorSum += error;
+	this->rangesSinceTrim++;
+
+	if (this->rangesSinceTrim < this->trimEveryRanges) {
+		return false;
+	}
+
+	float meanError = this->phaseErrorSum / this->rangesSinceTrim;
+	this->phaseErrorSum = 0;
+	this->rangesSinceTrim = 0;
+
+	// A range arriving late is pulled in by shortening the following periods, spread over the ranges until the next trim
+	double nominalPeriod = this->imuSamplesPerRange * imuPeriod;
+	double maxCorrection = PHASE_LOCK_MAX_TRIM * nominalPeriod;
+	double proportional = PHASE_LOCK_PROPORTIONAL_GAIN * meanError / this->trimEveryRanges;
+
+	// Anti-windup: the error isn't accumulated while the trim is already saturated in its direction, and the integral
+	// alone never asks for more than the largest trim, so it doesn't overshoot after a long disturbance
+	double output = proportional + PHASE_LOCK_INTEGRAL_GAIN * this->phaseErrorIntegral / this->trimEveryRanges;
+	bool saturated = std::fabs(output) >= maxCorrection && (meanError > 0) == (output > 0);
+	double integral = this->phaseErrorIntegral + meanError;
+	double integralLimit = maxCorrection * this->trimEveryRanges / PHASE_LOCK_INTEGRAL_GAIN;
+	if (!saturated) {
+		this->phaseErrorIntegral = integral < -integralLimit ? -integralLimit : (integral > integralLimit ? integralLimit : integral);
+	}
+
+	double correction = proportional + PHASE_LOCK_INTEGRAL_GAIN * this->phaseErrorIntegral / this->trimEveryRanges;
+	if (correction > maxCorrection) {
+		correction = maxCorrection;
+	} else if (correction < -maxCorrection) {
+		correction = -maxCorrection;
+	}
+
+	double periodTicksExact = (nominalPeriod - correction) * this->ticksPerMicrosecond;
+	if (!std::isfinite(this->ticksPerMicrosecond) || !(this->ticksPerMicrosecond > 0) ||
+		!std::isfinite(periodTicksExact) || !(periodTicksExact >= 1) || periodTicksExact > UINT32_MAX) {
+		return false;
+	}
+
+	uint32_t periodTicks = std::lround(periodTicksExact);
+	if (periodTicks == this->sensor.getInterMeasurementPeriodTicks()) {
+		return false;
+	}
+
+	this->sensor.setInterMeasurementPeriodTicks(periodTicks);
+	return true;
+}
+
+bool VL53L0XPhaseLock::isLocked() {
+	return this->imuCount >= PHASE_LOCK_MIN_SAMPLES && this->rangeCount >= PHASE_LOCK_MIN_SAMPLES;
+}
+
+float VL53L0XPhaseLock::getImuPeriod() {
+	if (this->imuCount < 2) {
+		return 0;
+	}
+
+	uint32_t samples = this->imuCount < PHASE_LOCK_WINDOW ? this->imuCount : PHASE_LOCK_WINDOW;
+	uint64_t newest = this->imuTimestamps[(this->imuCount - 1) % PHASE_LOCK_WINDOW];
+	uint64_t oldest = this->imuTimestamps[(this->imuCount - samples) % PHASE_LOCK_WINDOW];
+
+	return (float)(newest - oldest) / (samples - 1);
+}
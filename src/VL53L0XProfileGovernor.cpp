@@ -0,0 +1,137 @@
+#include "VL53L0XProfileGovernor.hpp"
+
+// M_PI, INFINITY
+#include <cmath>
+
+/*** Defines ***/
+
+// Consecutive updates asking for a slower profile before switching to it; faster profiles are applied immediately
+#define PROFILE_HOLD_UPDATES 3
+
+/*** Data tables ***/
+
+// Indexed by vl53l0xRangingProfile, budgets as listed in the README, limits and periods as in the API user manual
+static const VL53L0XProfileSettings PROFILE_SETTINGS[] = {
+	// Default
+	{30000, 0.25, 14, 10},
+	// High accuracy
+	{200000, 0.25, 14, 10},
+	// Long range
+	{33000, 0.1, 18, 14},
+	// High speed
+	{20000, 0.25, 14, 10}
+};
+
+/*** Constructors ***/
+
+VL53L0XProfileGovernor::VL53L0XProfileGovernor(VL53L0X &sensor, float targetSpacingMillimeters) : sensor(sensor) {
+	this->targetSpacingMillimeters = targetSpacingMillimeters;
+	this->longRangeMillimeters = 1200;
+	this->longRangeSignalRateMCPS = 1.0;
+	this->lastRangeMillimeters = 0;
+
+	this->current.measurementTimingBudgetMicroseconds = sensor.getMeasurementTimingBudget();
+	this->current.signalRateLimitMCPS = sensor.getSignalRateLimit();
+	this->current.preRangeVcselPeriodPCLKs = sensor.getVcselPulsePeriod(VcselPeriodPreRange);
+	this->current.finalRangeVcselPeriodPCLKs = sensor.getVcselPulsePeriod(VcselPeriodFinalRange);
+
+	this->profile = ProfileDefault;
+	this->candidate = ProfileDefault;
+	this->candidateCount = 0;
+	this->setProfile(ProfileDefault);
+}
+
+/*** Public Methods ***/
+
+bool VL53L0XProfileGovernor::update(float angularRateDegreesPerSecond, const VL53L0XRangingMeasurement &last) {
+	vl53l0xRangingProfile wanted = this->choose(angularRateDegreesPerSecond, last);
+
+	if (wanted == this->profile) {
+		this->candidateCount = 0;
+		return false;
+	}
+
+	if (wanted != this->candidate) {
+		this->candidate = wanted;
+		this->candidateCount = 0;
+	}
+	this->candidateCount++;
+
+	// Leaving for a faster profile can't wait, points are already too far apart
+	bool faster = PROFILE_SETTINGS[wanted].measurementTimingBudgetMicroseconds < PROFILE_SETTINGS[this->profile].measurementTimingBudgetMicroseconds;
+	if (!faster && this->candidateCount < PROFILE_HOLD_UPDATES) {
+		return false;
+	}
+
+	this->candidateCount = 0;
+	return this->setProfile(wanted);
+}
+
+bool VL53L0XProfileGovernor::setProfile(vl53l0xRangingProfile profile) {
+	const VL53L0XProfileSettings &settings = PROFILE_SETTINGS[profile];
+
+	if (settings.signalRateLimitMCPS != this->current.signalRateLimitMCPS) {
+		if (!this->sensor.setSignalRateLimit(settings.signalRateLimitMCPS)) {
+			return false;
+		}
+		this->current.signalRateLimitMCPS = settings.signalRateLimitMCPS;
+	}
+
+	// Changing a VCSEL period re-applies the timing budget and redoes the phase calibration on its own
+	if (settings.preRangeVcselPeriodPCLKs != this->current.preRangeVcselPeriodPCLKs) {
+		if (!this->sensor.setVcselPulsePeriod(VcselPeriodPreRange, settings.preRangeVcselPeriodPCLKs)) {
+			return false;
+		}
+		this->current.preRangeVcselPeriodPCLKs = settings.preRangeVcselPeriodPCLKs;
+	}
+	if (settings.finalRangeVcselPeriodPCLKs != this->current.finalRangeVcselPeriodPCLKs) {
+		if (!this->sensor.setVcselPulsePeriod(VcselPeriodFinalRange, settings.finalRangeVcselPeriodPCLKs)) {
+			return false;
+		}
+		this->current.finalRangeVcselPeriodPCLKs = settings.finalRangeVcselPeriodPCLKs;
+	}
+
+	if (settings.measurementTimingBudgetMicroseconds != this->current.measurementTimingBudgetMicroseconds) {
+		if (!this->sensor.setMeasurementTimingBudget(settings.measurementTimingBudgetMicroseconds)) {
+			return false;
+		}
+		this->current.measurementTimingBudgetMicroseconds = settings.measurementTimingBudgetMicroseconds;
+	}
+
+	this->profile = profile;
+	return true;
+}
+
+const VL53L0XProfileSettings& VL53L0XProfileGovernor::getProfileSettings(vl53l0xRangingProfile profile) {
+	return PROFILE_SETTINGS[profile];
+}
+
+/*** Private Methods ***/
+
+vl53l0xRangingProfile VL53L0XProfileGovernor::choose(float angularRateDegreesPerSecond, const VL53L0XRangingMeasurement &last) {
+	if (last.rangeStatus == RangeValid) {
+		this->lastRangeMillimeters = last.rangeMillimeters;
+	}
+
+	// Longest budget keeping the smear of one measurement on the surface under the target spacing
+	float sweepMillimetersPerSecond = std::fabs(angularRateDegreesPerSecond) * (float)M_PI / 180 * this->lastRangeMillimeters;
+	float allowedMicroseconds = INFINITY;
+	if (sweepMillimetersPerSecond > 0) {
+		allowedMicroseconds = this->targetSpacingMillimeters / sweepMillimetersPerSecond * 1000000;
+	}
+
+	bool farOrWeak = last.rangeStatus != RangeValid
+		|| last.rangeMillimeters > this->longRangeMillimeters
+		|| last.signalRateMCPS < this->longRangeSignalRateMCPS;
+
+	if (farOrWeak && allowedMicroseconds >= PROFILE_SETTINGS[ProfileLongRange].measurementTimingBudgetMicroseconds) {
+		return ProfileLongRange;
+	}
+	if (allowedMicroseconds >= PROFILE_SETTINGS[ProfileHighAccuracy].measurementTimingBudgetMicroseconds) {
+		return ProfileHighAccuracy;
+	}
+	if (allowedMicroseconds >= PROFILE_SETTINGS[ProfileDefault].measurementTimingBudgetMicroseconds) {
+		return ProfileDefault;
+	}
+	return ProfileHighSpeed;
+}
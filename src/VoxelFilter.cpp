@@ -0,0 +1,188 @@
+#include <cmath>
+
+#include "VoxelFilter.hpp"
+
+// Bits per coordinate in a key, enough for +-10km at 1cm
+#define KEY_BITS 21
+#define KEY_OFFSET (1 << (KEY_BITS - 1))
+#define KEY_MASK ((1ULL << KEY_BITS) - 1)
+
+// Not a valid key, the top bit is never used
+#define EMPTY_KEY UINT64_MAX
+
+// The table is swept once it's this full, linear probing slows down past it
+#define MAX_LOAD 0.7f
+// and evicts until it is below this
+#define TARGET_LOAD 0.5f
+
+VoxelFilter::VoxelFilter(PointStoreWriter &store, size_t capacity) : _store(store) {
+  size_t size = 16;
+  while(size < capacity) {
+    size <<= 1;
+  }
+  Voxel empty = {};
+  empty.key = EMPTY_KEY;
+  _table.assign(size, empty);
+  _scratch.assign(size, empty);
+  _mask = size - 1;
+  _voxels = 0;
+  _resolution = 0.01f;
+  _max_age = 2000000;
+  _newest = 0;
+  _batch_size = 0;
+  _points_in = 0;
+  _points_out = 0;
+  _failed = false;
+}
+
+bool VoxelFilter::set_resolution(float resolution) {
+  if(!(resolution > 0)) {
+    return false;
+  }
+  // Voxels of the old grid are written out, not merged with the new ones
+  evict(UINT64_MAX);
+  _resolution = resolution;
+  return true;
+}
+
+bool VoxelFilter::set_max_age(uint64_t max_age) {
+  _max_age = max_age;
+  return true;
+}
+
+/**
+ * @bref  Merge points into their voxels
+ * @param Points
+ * @param How many points
+ * @return true if success or false if the store failed
+ */
+bool VoxelFilter::insert(const ScanPoint *points, size_t count) {
+  for(size_t i = 0; i < count; ++i) {
+    const ScanPoint &point = points[i];
+    if(point.timestamp > _newest) {
+      _newest = point.timestamp;
+    }
+
+    uint64_t k = key(point.position);
+    size_t s = slot(k);
+    if(_table[s].key == EMPTY_KEY && _voxels + 1 > MAX_LOAD*(_mask + 1)) {
+      // Drop the stale voxels, then as many of the oldest as needed
+      uint64_t cutoff = _newest > _max_age ? _newest - _max_age : 0;
+      evict(cutoff);
+      while(_voxels > TARGET_LOAD*(_mask + 1)) {
+        cutoff += (_newest - cutoff)/2 + 1;
+        evict(cutoff);
+      }
+      s = slot(k);
+    }
+
+    Voxel &voxel = _table[s];
+    if(voxel.key == EMPTY_KEY) {
+      voxel.key = k;
+      voxel.count = 0;
+      voxel.position = {0, 0, 0};
+      voxel.origin = {0, 0, 0};
+      voxel.signal_rate = 0;
+      voxel.first_seen = point.timestamp;
+      ++_voxels;
+    }
+
+    // Incremental means stay accurate in float however many points come in
+    float w = 1.0f/++voxel.count;
+    voxel.position += (point.position - voxel.position)*w;
+    voxel.origin += (point.origin - voxel.origin)*w;
+    voxel.signal_rate += (point.signal_rate - voxel.signal_rate)*w;
+    voxel.sensor = point.sensor;
+    voxel.last_seen = point.timestamp;
+  }
+  _points_in += count;
+
+  return !_failed;
+}
+
+/**
+ * @bref  Write out every voxel and the pending batch
+ * @param None
+ * @return true if success or false if the store failed
+ */
+bool VoxelFilter::flush(void) {
+  evict(UINT64_MAX);
+  if(_batch_size > 0) {
+    _failed |= !_store.append(_batch, _batch_size);
+    _batch_size = 0;
+  }
+  return !_failed;
+}
+
+size_t VoxelFilter::get_voxels(void) {
+  return _voxels;
+}
+
+uint64_t VoxelFilter::get_points_in(void) {
+  return _points_in;
+}
+
+uint64_t VoxelFilter::get_points_out(void) {
+  return _points_out;
+}
+
+uint64_t VoxelFilter::key(const Vector3 &p) {
+  uint64_t x = (uint64_t)((int64_t)floorf(p.x/_resolution) + KEY_OFFSET) & KEY_MASK;
+  uint64_t y = (uint64_t)((int64_t)floorf(p.y/_resolution) + KEY_OFFSET) & KEY_MASK;
+  uint64_t z = (uint64_t)((int64_t)floorf(p.z/_resolution) + KEY_OFFSET) & KEY_MASK;
+  return x << (2*KEY_BITS) | y << KEY_BITS | z;
+}
+
+/**
+ * @bref  Find the slot of a key, or the empty slot where it goes
+ * @param Key
+ * @return Slot index
+ */
+size_t VoxelFilter::slot(uint64_t key) {
+  // Fibonacci hashing spreads the neighbouring keys of a surface
+  size_t s = (key*0x9e3779b97f4a7c15ULL) >> 32 & _mask;
+  while(_table[s].key != key && _table[s].key != EMPTY_KEY) {
+    s = (s + 1) & _mask;
+  }
+  return s;
+}
+
+/**
+ * @bref  Write out the voxels last seen before cutoff and rebuild the table
+ *        with the others, which also clears the probe chains
+ * @param Cutoff time
+ * @return None
+ */
+void VoxelFilter::evict(uint64_t cutoff) {
+  // The scratch table is always left empty
+  _table.swap(_scratch);
+  _voxels = 0;
+
+  for(Voxel &voxel : _scratch) {
+    if(voxel.key == EMPTY_KEY) {
+      continue;
+    }
+    if(voxel.last_seen < cutoff) {
+      emit(voxel);
+    } else {
+      _table[slot(voxel.key)] = voxel;
+      ++_voxels;
+    }
+    voxel.key = EMPTY_KEY;
+  }
+}
+
+void VoxelFilter::emit(const Voxel &voxel) {
+  ScanPoint &point = _batch[_batch_size++];
+  point.position = voxel.position;
+  point.origin = voxel.origin;
+  point.signal_rate = voxel.signal_rate;
+  point.sensor = voxel.sensor;
+  point.timestamp = voxel.first_seen + (voxel.last_seen - voxel.first_seen)/2;
+  ++_points_out;
+
+  if(_batch_size == VOXEL_FILTER_BATCH) {
+    _failed |= !_store.append(_batch, _batch_size);
+    _batch_size = 0;
+  }
+}
@@ -0,0 +1,132 @@
+#include <cmath>
+
+#include "ZUPT_Detector.hpp"
+
+#define STANDARD_GRAVITY 9.80665
+#define DEGREES_TO_RADIANS 0.017453292519943295f
+
+ZUPT_Detector::ZUPT_Detector(size_t window, float accel_sigma, float gyros_sigma, float threshold) {
+  _window = window < 2 ? 2 : (window > ZUPT_MAX_WINDOW ? ZUPT_MAX_WINDOW : window);
+  _inv_accel_var = 1/(accel_sigma*accel_sigma);
+  _inv_gyros_var = 1/(gyros_sigma*gyros_sigma);
+  _threshold = threshold;
+  _gyros_bias = {0, 0, 0};
+  _seed_enabled = true;
+  _seed_factor = 2;
+  reset();
+}
+
+/**
+ * @bref  Add a GY_85 sample, converting its units
+ * @param Sample
+ * @return true if the scanner is still
+ */
+bool ZUPT_Detector::update(const GY_85_Sample &sample) {
+  if(!sample.gyros_new) {
+    if(sample.accel_inactive && _seed_enabled) {
+      _seeded = _stationary = true;
+    }
+    return _stationary;
+  }
+
+  Vector3 accel = {sample.accel.x, sample.accel.y, sample.accel.z};
+  Vector3 gyros = {sample.gyros.x, sample.gyros.y, sample.gyros.z};
+  return update(accel*(float)STANDARD_GRAVITY, gyros*DEGREES_TO_RADIANS, sample.accel_inactive);
+}
+
+/**
+ * @bref  Slide the window by one sample and run the test
+ * @param Specific force in m/s²
+ * @param Angular rate in rad/s
+ * @param Whether the accelerometer reported inactivity
+ * @return true if the scanner is still
+ */
+bool ZUPT_Detector::update(const Vector3 &accel, const Vector3 &gyros, bool inactive) {
+  Vector3 w = gyros - _gyros_bias;
+  float energy = w.dot(w);
+
+  if(_count == _window) {
+    const Vector3 &old = _accel[_next];
+    _sum_ax -= old.x;
+    _sum_ay -= old.y;
+    _sum_az -= old.z;
+    _sum_a2 -= old.dot(old);
+    _sum_w2 -= _gyros_energy[_next];
+  } else {
+    ++_count;
+  }
+  _accel[_next] = accel;
+  _gyros_energy[_next] = energy;
+  _next = (_next + 1) % _window;
+  _sum_ax += accel.x;
+  _sum_ay += accel.y;
+  _sum_az += accel.z;
+  _sum_a2 += accel.dot(accel);
+  _sum_w2 += energy;
+
+  if(inactive && _seed_enabled) {
+    _seeded = true;
+  }
+
+  if(_count < _window) {
+    // Not enough samples for the test, only a seed can tell
+    _stationary = _seeded;
+    return _stationary;
+  }
+
+  // Sum of |a - g*u|² with u the mean direction, expanded into the running sums:
+  // sum|a|² - 2g*|sum a| + N*g²
+  double n = _count;
+  double sum_norm = std::sqrt(_sum_ax*_sum_ax + _sum_ay*_sum_ay + _sum_az*_sum_az);
+  double accel_term = _sum_a2 - 2*STANDARD_GRAVITY*sum_norm + n*STANDARD_GRAVITY*STANDARD_GRAVITY;
+  if(accel_term < 0) {
+    accel_term = 0;
+  }
+  _statistic = (accel_term*_inv_accel_var + _sum_w2*_inv_gyros_var)/n;
+
+  float threshold = _seeded ? _threshold*_seed_factor : _threshold;
+  _stationary = _statistic < threshold;
+  if(!_stationary) {
+    _seeded = false;
+  }
+
+  return _stationary;
+}
+
+bool ZUPT_Detector::is_stationary(void) {
+  return _stationary;
+}
+
+float ZUPT_Detector::get_statistic(void) {
+  return _statistic;
+}
+
+void ZUPT_Detector::set_threshold(float threshold) {
+  _threshold = threshold;
+}
+
+void ZUPT_Detector::set_gyros_bias(const Vector3 &bias) {
+  _gyros_bias = bias;
+}
+
+void ZUPT_Detector::set_inactivity_seed(bool enabled, float factor) {
+  _seed_enabled = enabled;
+  _seed_factor = factor;
+  if(!enabled) {
+    _seeded = false;
+  }
+}
+
+/**
+ * @bref  Empty the window
+ * @param None
+ * @return None
+ */
+void ZUPT_Detector::reset(void) {
+  _count = 0;
+  _next = 0;
+  _sum_ax = _sum_ay = _sum_az = _sum_a2 = _sum_w2 = 0;
+  _statistic = 0;
+  _stationary = false;
+  _seeded = false;
+}
@@ -2,12 +2,19 @@
 #include <unistd.h>
 #include <iomanip>
 #include <cmath>
+#include <chrono>
+#include <vector>
 
 #include "I2C.hpp"
 #include "VL53L0X.hpp"
 #include "ADXL345.hpp"
 #include "ITG_3205.hpp"
 #include "HMC5883L.hpp"
+#include "GY_85.hpp"
+#include "GY_85_Sampler.hpp"
+#include "AHRS.hpp"
+#include "ESKF.hpp"
+#include "ZUPT_Detector.hpp"
 
 void accuracy_vl53l0x(int n_samples) {
   I2C i2c("/dev/i2c-2");
@@ -41,6 +48,56 @@ void accuracy_vl53l0x(int n_samples) {
   std::cout << std::endl;
 }
 
+void startup_vl53l0x(int n_starts) {
+  I2C i2c("/dev/i2c-2");
+  VL53L0X distance_sensor(i2c);
+  distance_sensor.setTimeout(200);
+
+  // Full DataInit/StaticInit/calibration sequence, tuning table sent in bursts
+  double cold_ms = 0;
+  for(int i = 0; i < n_starts; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    distance_sensor.initialize();
+    cold_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  // The same tuning table register by register and as one transaction
+  double single_ms = 0, batched_ms = 0;
+  for(int i = 0; i < n_starts; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    distance_sensor.loadTuningSettings(false);
+    auto middle = std::chrono::steady_clock::now();
+    distance_sensor.loadTuningSettings(true);
+    single_ms += std::chrono::duration<double, std::milli>(middle - start).count();
+    batched_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - middle).count();
+  }
+
+  // The calibration cache goes into a directory of its own, removed afterwards
+  char cache_directory[] = "/tmp/vl53l0x_startupXXXXXX";
+  double warm_ms = 0;
+  if(mkdtemp(cache_directory) != nullptr) {
+    // First start fills the cache, the following ones restore from it
+    distance_sensor.initialize(cache_directory);
+    for(int i = 0; i < n_starts; ++i) {
+      auto start = std::chrono::steady_clock::now();
+      distance_sensor.initialize(cache_directory);
+      warm_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    char uid[17];
+    snprintf(uid, sizeof(uid), "%016llx", (unsigned long long)distance_sensor.getCalibration().uid);
+    unlink((std::string(cache_directory) + "/vl53l0x_" + uid + ".cal").c_str());
+    rmdir(cache_directory);
+  }
+
+  std::cout << "VL53L0X - Start-up time" << std::endl;
+  std::cout << "Cold start (ms): " << cold_ms/n_starts << std::endl;
+  std::cout << "Warm start (ms): " << warm_ms/n_starts << std::endl;
+  std::cout << "Tuning settings, per register (ms): " << single_ms/n_starts << std::endl;
+  std::cout << "Tuning settings, batched (ms): " << batched_ms/n_starts << std::endl;
+  std::cout << std::endl;
+}
+
 void accuracy_accelero(int n_samples) {
   I2C i2c("/dev/i2c-2");
   ADXL345 accelero(i2c);
@@ -168,12 +225,91 @@ void accuracy_magnetometer(int n_samples) {
   std::cout << std::endl;
 }
 
+void sampling_gy85(int seconds) {
+  I2C i2c("/dev/i2c-2");
+  GY_85 imu(i2c);
+  GY_85_Sampler sampler(imu, 100);
+  // Seeds the stillness test as soon as the accelerometer settles for a second
+  imu.set_inactivity_detection(50, 1);
+
+  // SCHED_FIFO needs privileges, without them sampling runs with the default policy
+  if(!sampler.start(50)) {
+    std::cout << "GY-85 sampling thread runs without real-time priority" << std::endl;
+  }
+
+  // Consumer wakes up rarely and takes everything in one batch
+  GY_85_Sample samples[GY_85_SAMPLER_CAPACITY];
+  AHRS ahrs(AHRS_MADGWICK);
+  ESKF pose;
+  ZUPT_Detector zupt;
+  int accel_new = 0, gyros_new = 0, magnt_new = 0, still = 0;
+  for(int i = 0; i < seconds*10; ++i) {
+    usleep(100000);
+    size_t count = sampler.drain(samples, GY_85_SAMPLER_CAPACITY);
+    ahrs.update(samples, count);
+    for(size_t j = 0; j < count; ++j) {
+      accel_new += samples[j].accel_new;
+      gyros_new += samples[j].gyros_new;
+      magnt_new += samples[j].magnt_new;
+
+      // Pauses between sweeps pin the velocity back to zero
+      pose.predict(samples[j]);
+      if(zupt.update(samples[j])) {
+        pose.update_zero_velocity();
+        ++still;
+      }
+      zupt.set_gyros_bias(pose.get_gyros_bias());
+    }
+  }
+  sampler.stop();
+
+  std::cout << "GY-85 - New samples per second" << std::endl;
+  std::cout << std::setw(20) << "Accelerometer" << std::setw(20) << "Gyroscope" << std::setw(20) << "Magnetometer" << std::endl;
+  std::cout << std::setw(20) << (double)accel_new/seconds << std::setw(20) << (double)gyros_new/seconds;
+  std::cout << std::setw(20) << (double)magnt_new/seconds << std::endl;
+  std::cout << "Overruns: " << sampler.get_overruns() << ", missed periods: " << sampler.get_missed_periods();
+  std::cout << ", read errors: " << sampler.get_read_errors() << std::endl;
+  Vector3 euler = ahrs.get_euler();
+  Vector3 position = pose.get_position();
+  std::cout << "Still " << (double)still/seconds << " samples per second, position " << position.x << ", ";
+  std::cout << position.y << ", " << position.z << " m" << std::endl;
+  std::cout << "Roll " << euler.x*180/M_PI << ", pitch " << euler.y*180/M_PI << ", yaw " << euler.z*180/M_PI << std::endl;
+  std::cout << std::endl;
+}
+
+void benchmark_ahrs(int n_updates) {
+  // Synthetic batch, a slow rotation with gravity and the field tilted away
+  // from the axes so every term of the corrections is exercised
+  std::vector<GY_85_Sample> samples(n_updates);
+  for(int i = 0; i < n_updates; ++i) {
+    samples[i].timestamp = 1000 + (uint64_t)i*1000;
+    samples[i].accel = {0.1f, -0.2f, 0.97f};
+    samples[i].gyros = {1.5f, -0.5f, 3.0f};
+    samples[i].magnt = {230, -40, -410};
+    samples[i].gyros_new = true;
+  }
+
+  std::cout << "AHRS - Updates per second on one core" << std::endl;
+  const char *names[] = {"Madgwick", "Mahony"};
+  for(int algorithm = AHRS_MADGWICK; algorithm <= AHRS_MAHONY; ++algorithm) {
+    AHRS ahrs((AHRS_Algorithm)algorithm, 0.1f, 0.01f);
+    auto start = std::chrono::steady_clock::now();
+    ahrs.update(samples.data(), samples.size());
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << std::setw(20) << names[algorithm] << std::setw(20) << n_updates/seconds << std::endl;
+  }
+  std::cout << std::endl;
+}
+
 int main(void) {
 
+  startup_vl53l0x(10);
   accuracy_vl53l0x(100);
   accuracy_accelero(100);
   accuracy_gyroscope(100);
   accuracy_magnetometer(100);
+  sampling_gy85(10);
+  benchmark_ahrs(1000000);
 
   return 0;
 }